@@ -3,6 +3,8 @@
 #include <limits.h>
 
 #include "readinputbinary.hpp"
+#include "reorder.hpp"
+#include "writeoutputbinary.hpp"
 
 #ifndef _PBBS_SPTL_BENCH_
 #define _PBBS_SPTL_BENCH_
@@ -46,6 +48,87 @@ void launch(int argc, char** argv, const Body& body) {
   printf("used_alpha %f\n", update_size_ratio);
 }
   
+// Writes xs to -outfile, if given, one after the other, in the formats
+// that read_from_file reads; prints the time this took and the number
+// of bytes written
+template <class... Items>
+void write_outfile(const Items&... xs) {
+  std::string outfile = deepsea::cmdline::parse_or_default_string("outfile", "");
+  if (outfile == "") {
+    return;
+  }
+  auto start = std::chrono::system_clock::now();
+  long bytes = 0;
+  {
+    output_file out(outfile);
+    int expand[] = { 0, (write_to_file(out, xs), 0)... };
+    (void)expand;
+    bytes = out.tell();
+  }
+  std::chrono::duration<float> diff = std::chrono::system_clock::now() - start;
+  printf("write_time %.3lf\n", diff.count());
+  printf("write_bytes %ld\n", bytes);
+}
+
+// Reads the csr_graph in infile, by a stream or, with -load mmap, by
+// mapping the file; -populate and -advice normal|sequential|random|willneed
+// tune the mapping. Prints the time this took, which exectime excludes.
+template <class intT>
+graph::csr_graph<intT> load_csr_graph(std::string infile) {
+  std::string load = deepsea::cmdline::parse_or_default_string("load", "stream");
+  auto start = std::chrono::system_clock::now();
+  graph::csr_graph<intT> x;
+  if (load == "stream") {
+    x = read_from_file<graph::csr_graph<intT>>(infile);
+  } else if (load == "mmap") {
+    bool populate = deepsea::cmdline::parse_or_default_bool("populate", false);
+    std::string advice = deepsea::cmdline::parse_or_default_string("advice", "normal");
+    int a = MADV_NORMAL;
+    if (advice == "sequential") {
+      a = MADV_SEQUENTIAL;
+    } else if (advice == "random") {
+      a = MADV_RANDOM;
+    } else if (advice == "willneed") {
+      a = MADV_WILLNEED;
+    } else if (advice != "normal") {
+      sptl::die("unknown advice %s", advice.c_str());
+    }
+    x = map_csr_graph<intT>(infile, populate, a);
+  } else {
+    sptl::die("unknown load %s", load.c_str());
+  }
+  std::chrono::duration<float> diff = std::chrono::system_clock::now() - start;
+  printf("load_time %.3lf\n", diff.count());
+  return x;
+}
+
+// Relabels the vertices of the graph x in the order that -reorder names:
+// none, degree or rcm, and prints the time this took. Returns the
+// permutation, which maps the old id of a vertex to its new one; it is
+// empty for none
+template <template <class> class Graph, class intT>
+parray<intT> reorder(Graph<intT>& x) {
+  std::string order = deepsea::cmdline::parse_or_default_string("reorder", "none");
+  parray<intT> perm;
+  if (order == "none") {
+    return perm;
+  }
+  auto start = std::chrono::system_clock::now();
+  if (order == "degree") {
+    perm = degree_order(x);
+  } else if (order == "rcm") {
+    perm = rcm_order(x);
+  } else {
+    sptl::die("unknown order %s", order.c_str());
+  }
+  Graph<intT> y = relabel(x, perm.begin());
+  x.del();
+  x = y;
+  std::chrono::duration<float> diff = std::chrono::system_clock::now() - start;
+  printf("reorder_time %.3lf\n", diff.count());
+  return perm;
+}
+  
 } // end namespace
 } // end namespace
 
@@ -1048,6 +1048,10 @@ let benchmarks' : benchmark_descriptor list = [
     bd_infiles = mk_samplesort_infiles;
     bd_input_descr = input_descriptor_samplesort;
   };
+  { bd_name = "mergesort";
+    bd_infiles = mk_samplesort_infiles;
+    bd_input_descr = input_descriptor_samplesort;
+  };
   { bd_name = "radixsort";
     bd_infiles = mk_radixsort_infiles;
     bd_input_descr = input_descriptor_radixsort;
@@ -3,6 +3,8 @@
 #include <functional>
 #include <stdlib.h>
 #include <algorithm>
+#include <chrono>
+#include <vector>
 
 #include "bench.hpp"
 
@@ -12,21 +14,69 @@
 template <class Item>
 using parray = sptl::parray<Item>;
 
+// Checks parents and levels, as filled by a BFS from source, against the
+// levels of a sequential BFS: every reached vertex but source must have
+// a neighbor one level closer as parent
+void check_tree(sptl::graph::csr_graph<intT>& x, int source, int* parents, int* levels) {
+  std::vector<int> expected(x.n, -1);
+  std::vector<int> queue(1, source);
+  expected[source] = 0;
+  for (size_t i = 0; i < queue.size(); i++) {
+    int v = queue[i];
+    for (int j = 0; j < x.degree(v); j++) {
+      int ngh = x.neighbors(v)[j];
+      if (expected[ngh] < 0) {
+        expected[ngh] = expected[v] + 1;
+        queue.push_back(ngh);
+      }
+    }
+  }
+  for (int v = 0; v < x.n; v++) {
+    if (levels[v] != expected[v]) {
+      sptl::die("bogus level %d for vertex %d, expected %d", levels[v], v, expected[v]);
+    }
+    int p = parents[v];
+    if (v == source || expected[v] < 0) {
+      if (p != (v == source ? source : -1)) {
+        sptl::die("bogus parent %d for vertex %d", p, v);
+      }
+      continue;
+    }
+    if (p < 0 || p >= x.n || expected[p] != expected[v] - 1 ||
+        std::find(x.neighbors(v), x.neighbors(v) + x.degree(v), p) == x.neighbors(v) + x.degree(v)) {
+      sptl::die("bogus parent %d for vertex %d", p, v);
+    }
+  }
+}
+
 void benchmark(sptl::bench::measured_type measured) {
   std::string infile = deepsea::cmdline::parse_or_default_string("infile", "");
   int source = deepsea::cmdline::parse_or_default_int("source", 0);
   if (infile == "") {
     sptl::die("missing infile");
   }
-  sptl::graph::graph<intT> x = sptl::read_from_file<sptl::graph::graph<intT>>(infile);
+  sptl::graph::csr_graph<intT> x = sptl::bench::load_csr_graph<intT>(infile);
+  // with -reorder, source names the same vertex, under its new id
+  parray<intT> perm = sptl::bench::reorder(x);
+  if (perm.size() > 0) {
+    source = perm[source];
+  }
   bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
+  // with -tree, the BFS also computes the parent and level of each vertex
+  bool tree = deepsea::cmdline::parse_or_default_bool("tree", false);
+  parray<int> parents;
+  parray<int> levels;
+  if (tree) {
+    parents.reset(x.n);
+    levels.reset(x.n);
+  }
   std::pair<intT,intT> pbbs_results;
   std::pair<intT,intT> sptl_results;
   auto do_pbbs = [&] {
     parray<pbbs::graph::vertex<int>> vs(x.n, [&] (int i) {
-      return pbbs::graph::vertex<int>(x.V[i].Neighbors, x.V[i].degree);
+      return pbbs::graph::vertex<int>(x.neighbors(i), x.degree(i));
     });
-    pbbs::graph::graph<intT> y(vs.begin(), x.n, x.m, x.allocatedInplace);
+    pbbs::graph::graph<intT> y(vs.begin(), x.n, (intT)x.m, x.edges);
     measured([&] {
       pbbs_results = pbbs::BFS(source, y);
     });
@@ -34,9 +84,88 @@ void benchmark(sptl::bench::measured_type measured) {
   deepsea::cmdline::dispatcher d;
   d.add("pbbs", do_pbbs);
   d.add("sptl", [&] {
-    measured([&] {
-      sptl_results = sptl::bfs(source, x);
-    });
+    // the algorithms run on x, or on its byte-coded compression
+    auto algorithms = [&] (const auto& g) {
+      deepsea::cmdline::dispatcher a;
+      a.add("top_down", [&] {
+        measured([&] {
+          if (tree) {
+            sptl_results = sptl::bfs(source, g, parents.begin(), levels.begin());
+          } else {
+            sptl_results = sptl::bfs(source, g);
+          }
+        });
+      });
+      a.add("direction_optimizing", [&] {
+        measured([&] {
+          if (tree) {
+            sptl_results = sptl::bfs_direction_optimizing(source, g, parents.begin(), levels.begin());
+          } else {
+            sptl_results = sptl::bfs_direction_optimizing(source, g);
+          }
+        });
+      });
+      // -sources searches, from source and from vertices picked at random,
+      // either batched or one after the other
+      int sources_number = deepsea::cmdline::parse_or_default_int("sources", 64);
+      parray<int> sources(sources_number, [&] (int i) {
+        return i == 0 ? source : (int)(sptl::hashi(i) % x.n);
+      });
+      parray<std::pair<int,int>> results(sources_number);
+      auto report = [&] (double elapsed) {
+        printf("queries_per_second %.2f\n", sources_number / elapsed);
+        sptl_results = results[0];
+        if (! should_check) {
+          return;
+        }
+        for (int i = 0; i < sources_number; i++) {
+          if (results[i] != sptl::bfs(sources[i], x)) {
+            sptl::die("bogus result for source %d", sources[i]);
+          }
+        }
+      };
+      a.add("multi_source", [&] {
+        double elapsed;
+        measured([&] {
+          auto start = std::chrono::steady_clock::now();
+          sptl::multi_source_bfs(sources.begin(), sources_number, g, results.begin());
+          elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+        report(elapsed);
+      });
+      a.add("repeated", [&] {
+        double elapsed;
+        measured([&] {
+          auto start = std::chrono::steady_clock::now();
+          for (int i = 0; i < sources_number; i++) {
+            results[i] = sptl::bfs(sources[i], g);
+          }
+          elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+        report(elapsed);
+      });
+      a.dispatch_or_default("algo", "top_down");
+    };
+    sptl::graph::byte_graph<intT> z;
+    std::string representation = deepsea::cmdline::parse_or_default_string("representation", "csr");
+    if (representation == "csr") {
+      printf("graph_bytes %ld\n", x.size_in_bytes());
+      algorithms(x);
+    } else if (representation == "bytes") {
+      z = sptl::graph::to_byte_graph(x);
+      printf("graph_bytes %ld\n", z.size_in_bytes());
+      algorithms(z);
+    } else {
+      sptl::die("unknown representation %s", representation.c_str());
+    }
+    if (tree) {
+      sptl::bench::write_outfile(sptl_results, parents, levels);
+    } else {
+      sptl::bench::write_outfile(sptl_results);
+    }
+    if (should_check && tree) {
+      check_tree(x, source, parents.begin(), levels.begin());
+    }
     if (should_check) {
       do_pbbs();
       if (pbbs_results.first != sptl_results.first) {
@@ -0,0 +1,213 @@
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "readinputbinary.hpp"
+
+#ifndef _PBBS_SPTL_CHUNKEDFILE
+#define _PBBS_SPTL_CHUNKEDFILE
+
+namespace sptl {
+
+// ***************************************************************
+//    Chunked files
+// ***************************************************************
+
+// A chunked file holds a sequence of elements of one type, cut into
+// chunks that can be read, checked and processed one at a time, so that
+// the sequence need not fit in memory:
+//
+//   header | chunk 0 | ... | chunk k - 1 | table
+//
+// The table holds the k + 1 offsets of the chunks in the file, the last
+// being the offset of the table itself, then, if the header says so, the
+// k checksums of the chunks. A writer appends the chunks as they come,
+// and writes the table and the header when it is closed.
+
+#define CHUNKED_MAGIC 0x314b4e4843535053ul
+// Default number of elements of a chunk
+#define CHUNKED_CHUNK (1 << 20)
+#define CHECKSUM_BLOCK (1 << 16)
+
+struct chunked_header {
+  unsigned long magic;
+  int type;
+  int checksummed;
+  long element_size;
+  long count;
+  long chunks;
+  // number of elements of the largest chunk
+  long max_chunk;
+  long table;
+};
+
+// Type codes of the elements, checked by readers; other types have code
+// 0 and are checked by their size only
+template <class Item>
+struct chunked_type { static const int value = 0; };
+template <>
+struct chunked_type<int> { static const int value = 1; };
+template <>
+struct chunked_type<long> { static const int value = 2; };
+template <>
+struct chunked_type<double> { static const int value = 3; };
+template <>
+struct chunked_type<std::pair<int, int>> { static const int value = 4; };
+template <>
+struct chunked_type<std::pair<long, long>> { static const int value = 5; };
+
+static inline unsigned long checksum_mix(unsigned long x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdul;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ul;
+  x ^= x >> 33;
+  return x;
+}
+
+// FNV-1a hashes of the blocks of CHECKSUM_BLOCK bytes, computed in
+// parallel, then mixed with their positions and summed
+static inline unsigned long chunk_checksum(const char* p, long bytes) {
+  long blocks = (bytes + CHECKSUM_BLOCK - 1) / CHECKSUM_BLOCK;
+  parray<unsigned long> h(blocks, [&] (long b) {
+    unsigned long x = 0xcbf29ce484222325ul;
+    for (long i = b * CHECKSUM_BLOCK; i < std::min(bytes, (b + 1) * CHECKSUM_BLOCK); i++) {
+      x = (x ^ (unsigned char)p[i]) * 0x100000001b3ul;
+    }
+    return checksum_mix(x + b);
+  });
+  unsigned long sum = 0;
+  for (long b = 0; b < blocks; b++) {
+    sum += h[b];
+  }
+  return sum;
+}
+
+template <class Item>
+class chunked_writer {
+  output_file out;
+  chunked_header header;
+  std::vector<long> offsets;
+  std::vector<unsigned long> checksums;
+public:
+  chunked_writer(std::string file, bool checksummed) : out(file) {
+    header.magic = CHUNKED_MAGIC;
+    header.type = chunked_type<Item>::value;
+    header.checksummed = checksummed;
+    header.element_size = sizeof(Item);
+    header.count = 0;
+    header.chunks = 0;
+    header.max_chunk = 0;
+    header.table = 0;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  // Appends a[0, n) as a new chunk
+  void append(const Item* a, long n) {
+    long bytes = sizeof(Item) * n;
+    offsets.push_back(out.tell());
+    if (header.checksummed) {
+      checksums.push_back(chunk_checksum(reinterpret_cast<const char*>(a), bytes));
+    }
+    out.write(reinterpret_cast<const char*>(a), bytes);
+    header.count += n;
+    header.chunks++;
+    header.max_chunk = std::max(header.max_chunk, n);
+  }
+  // Appends a[0, n) as chunks of chunk elements
+  void append_all(const Item* a, long n, long chunk) {
+    for (long lo = 0; lo < n; lo += chunk) {
+      append(a + lo, std::min(chunk, n - lo));
+    }
+  }
+  // Writes the table and the header; the writer cannot be used after
+  void close() {
+    header.table = out.tell();
+    offsets.push_back(header.table);
+    out.write(reinterpret_cast<const char*>(offsets.data()), sizeof(long) * offsets.size());
+    out.write(reinterpret_cast<const char*>(checksums.data()), sizeof(unsigned long) * checksums.size());
+    out.write_at(reinterpret_cast<const char*>(&header), sizeof(header), 0);
+  }
+};
+
+// Whether file starts like a chunked file
+static inline bool is_chunked_file(std::string file) {
+  unsigned long magic = 0;
+  int fd = open(file.c_str(), O_RDONLY);
+  bool chunked = fd >= 0 && pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) && magic == CHUNKED_MAGIC;
+  if (fd >= 0) {
+    close(fd);
+  }
+  return chunked;
+}
+
+template <class Item>
+class chunked_reader {
+  input_file in;
+  chunked_header header;
+  parray<long> offsets;
+  parray<unsigned long> checksums;
+public:
+  chunked_reader(std::string file) : in(file) {
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (header.magic != CHUNKED_MAGIC) {
+      sptl::die("%s is not a chunked file", file.c_str());
+    }
+    if (header.element_size != sizeof(Item) || header.type != chunked_type<Item>::value) {
+      sptl::die("%s holds elements of another type", file.c_str());
+    }
+    offsets.reset(header.chunks + 1);
+    in.seek(header.table);
+    in.read(reinterpret_cast<char*>(offsets.begin()), sizeof(long) * (header.chunks + 1));
+    if (header.checksummed) {
+      checksums.reset(header.chunks);
+      in.read(reinterpret_cast<char*>(checksums.begin()), sizeof(unsigned long) * header.chunks);
+    }
+  }
+  long count() const {
+    return header.count;
+  }
+  long chunks() const {
+    return header.chunks;
+  }
+  long max_chunk() const {
+    return header.max_chunk;
+  }
+  bool checksummed() const {
+    return header.checksummed;
+  }
+  // Number of elements of chunk i
+  long chunk_size(long i) const {
+    return (offsets[i + 1] - offsets[i]) / sizeof(Item);
+  }
+  // Reads chunk i into dst, and checks it against its checksum
+  void read_chunk(long i, Item* dst) {
+    long bytes = offsets[i + 1] - offsets[i];
+    in.read_at(reinterpret_cast<char*>(dst), bytes, offsets[i]);
+    if (header.checksummed && chunk_checksum(reinterpret_cast<const char*>(dst), bytes) != checksums[i]) {
+      sptl::die("bad checksum for chunk %ld", i);
+    }
+  }
+};
+
+// Converts a file in the format of parray<Item> into a chunked file of
+// chunk elements per chunk, one chunk in memory at a time
+template <class Item>
+void convert_to_chunked(std::string infile, std::string outfile, long chunk, bool checksummed) {
+  input_file in(infile);
+  long n = 0;
+  in.read(reinterpret_cast<char*>(&n), sizeof(long));
+  chunked_writer<Item> out(outfile, checksummed);
+  parray<Item> buffer;
+  buffer.reset(std::min(chunk, n));
+  for (long lo = 0; lo < n; lo += chunk) {
+    long size = std::min(chunk, n - lo);
+    in.read(reinterpret_cast<char*>(buffer.begin()), sizeof(Item) * size);
+    out.append(buffer.begin(), size);
+  }
+  out.close();
+}
+
+} // end namespace
+
+#endif
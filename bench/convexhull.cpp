@@ -28,6 +28,7 @@ void benchmark(sptl::bench::measured_type measured, parray<sptl::_point2d<double
     measured([&] {
       sptl_result = sptl::hull(x);
     });
+    sptl::bench::write_outfile(sptl_result);
     if (deepsea::cmdline::parse_or_default_bool("check", false)) {
       do_pbbs();
       if (pbbs_result.n != sptl_result.size()) {
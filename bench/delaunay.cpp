@@ -34,6 +34,7 @@ void benchmark(sptl::bench::measured_type measured) {
     measured([&] {
       sptl_result = sptl::delaunay(x);
     });
+    sptl::bench::write_outfile(sptl_result);
     if (should_check) {
       // todo
     }
@@ -0,0 +1,240 @@
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+
+#include "bench.hpp"
+#include "chunkedfile.hpp"
+#include "merge.hpp"
+
+#ifndef _PBBS_SPTL_EXTERNALSORT
+#define _PBBS_SPTL_EXTERNALSORT
+
+namespace sptl {
+
+// ***************************************************************
+//    External sort
+// ***************************************************************
+
+// external_sort sorts a chunked file that need not fit in memory, in two
+// passes over the disk:
+//  - the first reads the chunks into a buffer of memory elements, sorts
+//    the buffer in memory by sort(a, n), which is parallel, and writes it
+//    as a run, a chunked file of its own, whenever the next chunk does
+//    not fit
+//  - the second merges the runs by rounds. Each run holds a window of
+//    its next elements in memory, of one or two chunks. The elements no
+//    greater than the least last element of the windows of the runs that
+//    have chunks left on disk are merged in parallel by multiway_merge and
+//    appended to the output; meanwhile, the runs whose windows get short
+//    read their next chunk.
+// The runs are written in chunks small enough that three chunks of each
+// run, for its window and its next chunk, and the output of a round fit
+// in memory elements; there are at most twice as many runs as count /
+// memory, as buffers hold whole chunks. If there is a single run, it is
+// the output. Returns the number of runs.
+
+template <class Item, class Sort, class Compare>
+long external_sort(std::string infile, std::string outfile, long memory, Sort sort, Compare compare) {
+  chunked_reader<Item> in(infile);
+  long capacity = std::max(memory, in.max_chunk());
+  long max_runs = 2 * ((in.count() + capacity - 1) / capacity);
+  long block = std::max(1l, capacity / (5 * max_runs + 1));
+  bool checksummed = in.checksummed();
+  std::vector<std::string> runs;
+  parray<Item> buffer;
+  buffer.reset(capacity);
+  long size = 0;
+  auto write_run = [&] {
+    runs.push_back(outfile + ".run" + std::to_string(runs.size()));
+    sort(buffer.begin(), size);
+    chunked_writer<Item> run(runs.back(), checksummed);
+    run.append_all(buffer.begin(), size, block);
+    run.close();
+    size = 0;
+  };
+  for (long i = 0; i < in.chunks(); i++) {
+    if (size + in.chunk_size(i) > capacity) {
+      write_run();
+    }
+    in.read_chunk(i, buffer.begin() + size);
+    size += in.chunk_size(i);
+  }
+  if (size > 0 || runs.empty()) {
+    write_run();
+  }
+  buffer.clear();
+  if (runs.size() == 1) {
+    if (rename(runs[0].c_str(), outfile.c_str()) != 0) {
+      sptl::die("cannot rename %s", runs[0].c_str());
+    }
+    return 1;
+  }
+  int k = (int)runs.size();
+  std::vector<chunked_reader<Item>*> readers(k);
+  // the window of run r is windows[r][lo[r], hi[r]), and next[r] is its
+  // next chunk on disk
+  std::vector<parray<Item>> windows(k);
+  parray<long> lo(k, 0l);
+  parray<long> hi(k, 0l);
+  parray<long> next(k, 0l);
+  parray<long> cut(k);
+  parray<long> lengths(k);
+  parray<Item*> heads(k);
+  parray<bool> refill(k);
+  for (int r = 0; r < k; r++) {
+    readers[r] = new chunked_reader<Item>(runs[r]);
+    windows[r].reset(3 * std::max(1l, readers[r]->max_chunk()));
+    if (readers[r]->chunks() > 0) {
+      readers[r]->read_chunk(0, windows[r].begin());
+      hi[r] = readers[r]->chunk_size(0);
+      next[r] = 1;
+    }
+  }
+  chunked_writer<Item> out(outfile, checksummed);
+  parray<Item> output;
+  output.reset(2 * k * block);
+  while (true) {
+    // elements of other runs up to the bound can be output: those still
+    // on disk are no less than the last element of their window
+    int j = -1;
+    for (int r = 0; r < k; r++) {
+      if (next[r] < readers[r]->chunks() && (j < 0 || compare(windows[r][hi[r] - 1], windows[j][hi[j] - 1]))) {
+        j = r;
+      }
+    }
+    long total = 0;
+    for (int r = 0; r < k; r++) {
+      Item* w = windows[r].begin();
+      cut[r] = (j < 0) ? hi[r] : std::upper_bound(w + lo[r], w + hi[r], windows[j][hi[j] - 1], compare) - w;
+      heads[r] = w + lo[r];
+      lengths[r] = cut[r] - lo[r];
+      total += lengths[r];
+      refill[r] = next[r] < readers[r]->chunks() && hi[r] - cut[r] <= block;
+    }
+    if (total == 0) {
+      break;
+    }
+    // the next chunks go after the windows, which fit in two chunks, and
+    // are read while the round is merged
+    fork2([&] {
+      multiway_merge(heads.begin(), lengths.begin(), k, output.begin(), compare);
+    }, [&] {
+      for (int r = 0; r < k; r++) {
+        if (refill[r]) {
+          readers[r]->read_chunk(next[r], windows[r].begin() + hi[r]);
+        }
+      }
+    });
+    out.append(output.begin(), total);
+    for (int r = 0; r < k; r++) {
+      lo[r] = cut[r];
+      if (refill[r]) {
+        // the window moves to the front, to leave room for the next chunk
+        hi[r] += readers[r]->chunk_size(next[r]++);
+        Item* w = windows[r].begin();
+        if (lo[r] > 0) {
+          std::copy(w + lo[r], w + hi[r], w);
+        }
+        hi[r] -= lo[r];
+        lo[r] = 0;
+      }
+    }
+  }
+  out.close();
+  for (int r = 0; r < k; r++) {
+    delete readers[r];
+    unlink(runs[r].c_str());
+  }
+  return k;
+}
+
+namespace bench {
+
+// Sum of the hashes of the elements of a chunked file, which does not
+// depend on their order
+template <class Item>
+unsigned long chunked_fingerprint(chunked_reader<Item>& in, parray<Item>& buffer) {
+  unsigned long sum = 0;
+  for (long i = 0; i < in.chunks(); i++) {
+    in.read_chunk(i, buffer.begin());
+    sum += level1::reduce(buffer.begin(), buffer.begin() + in.chunk_size(i), 0ul, [&] (unsigned long x, unsigned long y) {
+      return x + y;
+    }, [&] (const Item& x) {
+      const unsigned char* p = reinterpret_cast<const unsigned char*>(&x);
+      unsigned long h = 0xcbf29ce484222325ul;
+      for (size_t j = 0; j < sizeof(Item); j++) {
+        h = (h ^ p[j]) * 0x100000001b3ul;
+      }
+      return checksum_mix(h);
+    });
+  }
+  return sum;
+}
+
+// Sorts -infile into -outfile by external_sort, with at most -memory
+// elements in memory; the sort is measured as a whole, disk traffic
+// included, and the number of runs is printed. An -infile in the format
+// of parray<Item> is first converted, unmeasured, into the chunked file
+// -infile.chunked, with chunks of -chunk elements, checksummed with
+// -checksums. With -check, the output is streamed to check that it is
+// sorted and holds the elements of the input.
+template <class Item, class Sort, class Compare>
+void external_sort_benchmark(measured_type measured, Sort sort, Compare compare) {
+  std::string infile = deepsea::cmdline::parse_or_default_string("infile", "");
+  std::string outfile = deepsea::cmdline::parse_or_default_string("outfile", "");
+  if (infile == "" || outfile == "") {
+    sptl::die("external sort needs an infile and an outfile");
+  }
+  long memory = deepsea::cmdline::parse_or_default_long("memory", 1l << 27);
+  if (memory <= 0) {
+    sptl::die("external sort needs a positive memory");
+  }
+  if (! is_chunked_file(infile)) {
+    long chunk = deepsea::cmdline::parse_or_default_long("chunk", CHUNKED_CHUNK);
+    if (chunk <= 0) {
+      sptl::die("external sort needs a positive chunk");
+    }
+    bool checksums = deepsea::cmdline::parse_or_default_bool("checksums", false);
+    convert_to_chunked<Item>(infile, infile + ".chunked", chunk, checksums);
+    infile += ".chunked";
+  }
+  long runs = 0;
+  measured([&] {
+    runs = external_sort<Item>(infile, outfile, memory, sort, compare);
+  });
+  printf("runs %ld\n", runs);
+  if (! deepsea::cmdline::parse_or_default_bool("check", false)) {
+    return;
+  }
+  chunked_reader<Item> in(infile);
+  chunked_reader<Item> out(outfile);
+  parray<Item> buffer;
+  buffer.reset(std::max(1l, std::max(in.max_chunk(), out.max_chunk())));
+  if (in.count() != out.count() || chunked_fingerprint(in, buffer) != chunked_fingerprint(out, buffer)) {
+    sptl::die("the output does not hold the elements of the input");
+  }
+  if (out.chunks() == 0) {
+    return;
+  }
+  out.read_chunk(0, buffer.begin());
+  Item last = buffer[0];
+  for (long i = 0; i < out.chunks(); i++) {
+    if (i > 0) {
+      out.read_chunk(i, buffer.begin());
+    }
+    for (long j = 0; j < out.chunk_size(i); j++) {
+      if (compare(buffer[j], last)) {
+        sptl::die("bogus result in chunk %ld", i);
+      }
+      last = buffer[j];
+    }
+  }
+}
+
+} // end namespace
+} // end namespace
+
+#endif
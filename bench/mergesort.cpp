@@ -0,0 +1,136 @@
+
+#include <math.h>
+#include <functional>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "bench.hpp"
+
+#include "merge.hpp"
+#include "samplesort.hpp"
+#include "sampleSort.h"
+
+template <class Item>
+using parray = sptl::parray<Item>;
+
+// Rearranges x as requested by the -presort option: "sorted", or
+// "almost_sorted" (sorted, then sqrt(n) random pairs swapped)
+template <class Item, class Compare>
+void presort(parray<Item>& x, const Compare& compare) {
+  std::string presort = deepsea::cmdline::parse_or_default_string("presort", "none");
+  if (presort == "none") {
+    return;
+  }
+  std::sort(x.begin(), x.end(), compare);
+  if (presort == "almost_sorted") {
+    long n = x.size();
+    long swaps = (long)sqrt(n);
+    for (long i = 0; i < swaps; i++) {
+      std::swap(x[sptl::hashi(2 * i) % n], x[sptl::hashi(2 * i + 1) % n]);
+    }
+  } else if (presort != "sorted") {
+    sptl::die("unknown presort %s", presort.c_str());
+  }
+}
+
+template <class Item, class Compare>
+void benchmark(sptl::bench::measured_type measured,
+               parray<Item>& x,
+               const Compare& compare) {
+  bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
+  presort(x, compare);
+  parray<Item> ref;
+  if (should_check) {
+    ref = x;
+  }
+  // writes the sorted y to -outfile, and checks it
+  auto check = [&] (parray<Item>& y) {
+    sptl::bench::write_outfile(y);
+    if (! should_check) {
+      return;
+    }
+    std::stable_sort(ref.begin(), ref.end(), compare);
+    auto it_ref = ref.begin();
+    for (auto it = y.begin(); it != y.end(); it++) {
+      if (compare(*it, *it_ref) || compare(*it_ref, *it)) {
+        std::cerr << "bogus result" << std::endl;
+        exit(0);
+      }
+      it_ref++;
+    }
+  };
+  deepsea::cmdline::dispatcher d;
+  d.add("pbbs", [&] {
+    measured([&] {
+      pbbs::sampleSort(x.begin(), (int)x.size(), compare);
+    });
+  });
+  d.add("sptl", [&] {
+    deepsea::cmdline::dispatcher a;
+    a.add("merge_sort", [&] {
+      measured([&] {
+        sptl::merge_sort(x.begin(), (int)x.size(), compare);
+      });
+      check(x);
+    });
+    a.add("sample_sort", [&] {
+      measured([&] {
+        sptl::sample_sort(x.begin(), (int)x.size(), compare);
+      });
+      check(x);
+    });
+    a.add("stable_sample_sort", [&] {
+      measured([&] {
+        sptl::stable_sample_sort(x.begin(), (int)x.size(), compare);
+      });
+      check(x);
+    });
+    // merges the input, cut into -runs sorted runs
+    a.add("multiway_merge", [&] {
+      int n = (int)x.size();
+      int k = std::max(1, deepsea::cmdline::parse_or_default_int("runs", 16));
+      int chunk = (n + k - 1) / k;
+      parray<Item*> runs(k, [&] (int i) {
+        return x.begin() + std::min(n, i * chunk);
+      });
+      parray<int> lengths(k, [&] (int i) {
+        return std::max(0, std::min(chunk, n - i * chunk));
+      });
+      sptl::parallel_for(0, k, [&] (int i) {
+        std::sort(runs[i], runs[i] + lengths[i], compare);
+      });
+      parray<Item> y;
+      y.reset(n);
+      measured([&] {
+        sptl::multiway_merge(runs.begin(), lengths.begin(), k, y.begin(), compare);
+      });
+      check(y);
+    });
+    a.dispatch_or_default("algo", "merge_sort");
+  });
+  d.dispatch("library");
+}
+
+template <class Item, class Compare>
+void benchmark(sptl::bench::measured_type measured,
+               const Compare& compare) {
+  std::string infile = deepsea::cmdline::parse_or_default_string("infile", "");
+  if (infile == "") {
+    sptl::die("missing infile");
+  }
+  parray<Item> x = sptl::read_from_file<parray<Item>>(infile);
+  benchmark(measured, x, compare);
+}
+
+int main(int argc, char** argv) {
+  sptl::bench::launch(argc, argv, [&] (sptl::bench::measured_type measured) {
+    deepsea::cmdline::dispatcher d;
+    d.add("double", [&] {
+      benchmark<double>(measured, std::less<double>());
+    });
+    d.add("int", [&]  {
+      benchmark<int>(measured, std::less<int>());
+    });
+    d.dispatch("type");
+  });
+}
@@ -12,20 +12,45 @@
 template <class Item>
 using parray = sptl::parray<Item>;
 
+// Dies unless flags marks an independent set of x, with 1, that is
+// maximal: every other vertex, marked 2, has a neighbor in the set
+void check_mis(const sptl::graph::csr_graph<intT>& x, const char* flags) {
+  sptl::parallel_for((intT)0, x.n, [&] (intT v) {
+    bool covered = false;
+    for (intT j = 0; j < x.degree(v); j++) {
+      intT ngh = x.neighbors(v)[j];
+      if (flags[v] == 1 && flags[ngh] == 1 && ngh != v) {
+        sptl::die("vertices %d and %d are both in the set", v, ngh);
+      }
+      covered = covered || flags[ngh] == 1;
+    }
+    if (flags[v] != 1 && ! (flags[v] == 2 && covered)) {
+      sptl::die("vertex %d can join the set", v);
+    }
+  });
+}
+
 void benchmark(sptl::bench::measured_type measured) {
   std::string infile = deepsea::cmdline::parse_or_default_string("infile", "");
   if (infile == "") {
     sptl::die("missing infile");
   }
-  sptl::graph::graph<intT> x = sptl::read_from_file<sptl::graph::graph<intT>>(infile);
+  sptl::graph::csr_graph<intT> x = sptl::bench::load_csr_graph<intT>(infile);
+  parray<intT> perm = sptl::bench::reorder(x);
+  // the ranks of the vertices are their old ids, so that the rounds of
+  // the MIS are those of the original graph, whatever the new ids
+  parray<intT> rank;
+  if (perm.size() > 0) {
+    rank = sptl::inverse_permutation(perm.begin(), x.n);
+  }
   bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
   parray<char> sptl_results;
   char* pbbs_results = nullptr;
   auto do_pbbs = [&] {
     parray<pbbs::graph::vertex<intT>> vs(x.n, [&] (intT i) {
-      return pbbs::graph::vertex<intT>(x.V[i].Neighbors, x.V[i].degree);
+      return pbbs::graph::vertex<intT>(x.neighbors(i), x.degree(i));
     });
-    pbbs::graph::graph<intT> y(vs.begin(), x.n, x.m, x.allocatedInplace);
+    pbbs::graph::graph<intT> y(vs.begin(), x.n, (intT)x.m, x.edges);
     measured([&] {
       pbbs_results = pbbs::maximalIndependentSet(y);
     });
@@ -33,10 +58,30 @@ void benchmark(sptl::bench::measured_type measured) {
   deepsea::cmdline::dispatcher d;
   d.add("pbbs", do_pbbs);
   d.add("sptl", [&] {
-    measured([&] {
-      sptl_results = sptl::maximalIndependentSet(x);
-    });
-    if (should_check) {
+    // the MIS runs on x, or on its byte-coded compression
+    auto algorithm = [&] (const auto& g) {
+      measured([&] {
+        sptl_results = sptl::maximalIndependentSet(g, (perm.size() > 0) ? rank.begin() : NULL);
+      });
+    };
+    sptl::graph::byte_graph<intT> z;
+    std::string representation = deepsea::cmdline::parse_or_default_string("representation", "csr");
+    if (representation == "csr") {
+      printf("graph_bytes %ld\n", x.size_in_bytes());
+      algorithm(x);
+    } else if (representation == "bytes") {
+      z = sptl::graph::to_byte_graph(x);
+      printf("graph_bytes %ld\n", z.size_in_bytes());
+      algorithm(z);
+    } else {
+      sptl::die("unknown representation %s", representation.c_str());
+    }
+    sptl::bench::write_outfile(sptl_results);
+    if (should_check && perm.size() > 0) {
+      // the set is the first one in the order of the old ids, while
+      // pbbs follows the new ones
+      check_mis(x, sptl_results.begin());
+    } else if (should_check) {
       do_pbbs();
       for (intT i = 0; i < sptl_results.size(); i++) {
         if (sptl_results[i] != pbbs_results[i]) {
@@ -38,6 +38,7 @@ void benchmark(sptl::bench::measured_type measured) {
     measured([&] {
       sptl_results = sptl::mst(edges);
     });
+    sptl::bench::write_outfile(sptl_results);
     if (should_check) {
       do_pbbs();
       for (intT i = 0; i < sptl_results.size(); i++) {
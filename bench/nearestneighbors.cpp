@@ -39,6 +39,7 @@ void benchmark(sptl::bench::measured_type measured,
     measured([&] {
       sptl_result = sptl::ANN<int, K, Item_sptl>(x, (int)x.size(), k);
     });
+    sptl::bench::write_outfile(sptl_result);
     if (should_check) {
       do_pbbs();
       for (intT i = 0; i < pbbs_result.size(); i++) {
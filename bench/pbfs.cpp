@@ -18,15 +18,15 @@ void benchmark(sptl::bench::measured_type measured) {
   if (infile == "") {
     sptl::die("missing infile");
   }
-  sptl::graph::graph<intT> x = sptl::read_from_file<sptl::graph::graph<intT>>(infile);
+  sptl::graph::csr_graph<intT> x = sptl::bench::load_csr_graph<intT>(infile);
   bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
   std::pair<intT,intT> pbbs_results;
   std::pair<intT,intT> sptl_results;
   auto do_pbbs = [&] {
     parray<pbbs::graph::vertex<intT>> vs(x.n, [&] (intT i) {
-      return pbbs::graph::vertex<int>(x.V[i].Neighbors, x.V[i].degree);
+      return pbbs::graph::vertex<int>(x.neighbors(i), x.degree(i));
     });
-    pbbs::graph::graph<intT> y(vs.begin(), x.n, x.m, x.allocatedInplace);
+    pbbs::graph::graph<intT> y(vs.begin(), x.n, (intT)x.m, x.edges);
     measured([&] {
       pbbs_results = pbbs::pBFS(source, y);
     });
@@ -34,9 +34,25 @@ void benchmark(sptl::bench::measured_type measured) {
   deepsea::cmdline::dispatcher d;
   d.add("pbbs", do_pbbs);
   d.add("sptl", [&] {
-    measured([&] {
-      sptl_results = sptl::pbfs(source, x);
-    });
+    // pbfs runs on x, or on its byte-coded compression
+    auto algorithm = [&] (const auto& g) {
+      measured([&] {
+        sptl_results = sptl::pbfs(source, g);
+      });
+    };
+    sptl::graph::byte_graph<intT> z;
+    std::string representation = deepsea::cmdline::parse_or_default_string("representation", "csr");
+    if (representation == "csr") {
+      printf("graph_bytes %ld\n", x.size_in_bytes());
+      algorithm(x);
+    } else if (representation == "bytes") {
+      z = sptl::graph::to_byte_graph(x);
+      printf("graph_bytes %ld\n", z.size_in_bytes());
+      algorithm(z);
+    } else {
+      sptl::die("unknown representation %s", representation.c_str());
+    }
+    sptl::bench::write_outfile(sptl_results);
     if (should_check) {
       do_pbbs();
       if (pbbs_results.first != sptl_results.first) {
@@ -5,13 +5,59 @@
 #include <algorithm>
 
 #include "bench.hpp"
+#include "externalsort.hpp"
 
 #include "blockradixsort.hpp"
+#include "sort.hpp"
 #include "blockRadixSort.h"
 
 template <class Item>
 using parray = sptl::parray<Item>;
 
+template <class Item>
+struct key_of {
+  using type = Item;
+  static type get(const Item& x) {
+    return x;
+  }
+};
+
+template <class Key, class Value>
+struct key_of<std::pair<Key, Value>> {
+  using type = Key;
+  static type get(const std::pair<Key, Value>& x) {
+    return x.first;
+  }
+};
+
+// Sorts the pairs of x by their first components with sort_by_key, on
+// separate key and value arrays; the split is not measured
+template <class Item>
+void sort_by_key(sptl::bench::measured_type measured, parray<Item>& x) {
+  sptl::die("by_key needs a pair type");
+}
+
+template <class Key, class Value>
+void sort_by_key(sptl::bench::measured_type measured, parray<std::pair<Key, Value>>& x) {
+  long n = x.size();
+  parray<Key> keys(n, [&] (long i) {
+    return x[i].first;
+  });
+  parray<Value> values(n, [&] (long i) {
+    return x[i].second;
+  });
+  measured([&] {
+    sptl::sort_by_key(keys.begin(), values.begin(), n);
+  });
+  sptl::parallel_for(0l, n, [&] (long i) {
+    x[i] = std::make_pair(keys[i], values[i]);
+  });
+}
+
+// 64-bit keys are sorted with 64-bit counts
+template <class Item>
+using count_of = typename std::conditional<(sizeof(typename key_of<Item>::type) > 4), long, int>::type;
+
 template <class Item>
 void benchmark(sptl::bench::measured_type measured, parray<Item>& x) {
   bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
@@ -26,11 +72,34 @@ void benchmark(sptl::bench::measured_type measured, parray<Item>& x) {
     });
   });
   d.add("sptl", [&] {
-    measured([&] {
-      sptl::integer_sort(x.begin(), (int)x.size());
+    deepsea::cmdline::dispatcher a;
+    a.add("block", [&] {
+      measured([&] {
+        sptl::integer_sort(x.begin(), (count_of<Item>)x.size());
+      });
+    });
+    a.add("inplace", [&] {
+      measured([&] {
+        sptl::integer_sort_in_place(x.begin(), (count_of<Item>)x.size());
+      });
     });
+    a.add("wc", [&] {
+      int radix_bits = deepsea::cmdline::parse_or_default_int("radix_bits", WC_RADIX);
+      measured([&] {
+        sptl::integer_sort_wc(x.begin(), (count_of<Item>)x.size(), radix_bits);
+      });
+    });
+    a.add("by_key", [&] {
+      sort_by_key(measured, x);
+    });
+    a.dispatch_or_default("algo", "block");
+    sptl::bench::write_outfile(x);
     if (should_check) {
-      std::sort(ref.begin(), ref.end());
+      // sort_by_key is stable, and the other algorithms are checked
+      // on inputs whose keys are distinct
+      std::stable_sort(ref.begin(), ref.end(), [&] (const Item& a, const Item& b) {
+        return key_of<Item>::get(a) < key_of<Item>::get(b);
+      });
       auto it_ref = ref.begin();
       for (auto it = x.begin(); it != x.end(); it++) {
         if (*it != *it_ref) {
@@ -46,6 +115,16 @@ void benchmark(sptl::bench::measured_type measured, parray<Item>& x) {
 
 template <class Item>
 void benchmark(sptl::bench::measured_type measured) {
+  // with -external, the input is sorted out of core
+  if (deepsea::cmdline::parse_or_default_bool("external", false)) {
+    sptl::bench::external_sort_benchmark<Item>(measured, [&] (Item* a, long n) {
+      // a run can hold more than 2^31 elements
+      sptl::integer_sort(a, n);
+    }, [&] (const Item& a, const Item& b) {
+      return key_of<Item>::get(a) < key_of<Item>::get(b);
+    });
+    return;
+  }
   std::string infile = deepsea::cmdline::parse_or_default_string("infile", "");
   if (infile == "") {
     sptl::die("missing infile");
@@ -63,6 +142,12 @@ int main(int argc, char** argv) {
     d.add("pair_int_int", [&]  {
       benchmark<std::pair<int, int>>(measured);
     });
+    d.add("long", [&] {
+      benchmark<long>(measured);
+    });
+    d.add("pair_long_long", [&]  {
+      benchmark<std::pair<long, long>>(measured);
+    });
     d.dispatch("type");
   });
 }
@@ -61,6 +61,7 @@ void benchmark(sptl::bench::measured_type measured) {
     measured([&] {
       sptl_result = sptl::kdtree::ray_cast(tri, x.rays.begin(), x.rays.size());
     });
+    sptl::bench::write_outfile(sptl_result);
     if (should_check) {
       do_pbbs();
       for (intT i = 0; i < sptl_result.size(); i++) {
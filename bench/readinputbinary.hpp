@@ -1,7 +1,11 @@
 
 #include <string>
 #include <cstring>
-#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "geometrydata.hpp"
 #include "graph.hpp"
@@ -11,12 +15,237 @@
 
 namespace sptl {
 
+// ***************************************************************
+//    Parallel input and output
+// ***************************************************************
+
+// An input_file reads a binary file from front to back, by pread. A
+// payload of more than READ_CHUNK bytes is cut into chunks, which
+// parallel tasks read straight into the destination: the tasks share the
+// copies out of the page cache, and the pages of the destination are
+// first touched by several workers, so that they spread over sockets.
+// An output_file writes the same way, by pwrite.
+
+#define READ_CHUNK (1 << 22)
+// Number of segments of a preadv, at most IOV_MAX
+#define READ_SEGMENTS 1024
+
+class input_file {
+  int fd;
+  long offset;
+public:
+  input_file(std::string file) : offset(0) {
+    fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+      sptl::die("cannot open %s", file.c_str());
+    }
+  }
+  ~input_file() {
+    close(fd);
+  }
+  // Reads the bytes of the file at [position, position + bytes) into dst
+  void read_at(char* dst, long bytes, long position) {
+    long chunks = (bytes + READ_CHUNK - 1) / READ_CHUNK;
+    parallel_for(0l, chunks, [&] (long c) {
+      long lo = c * READ_CHUNK;
+      long hi = std::min(bytes, lo + READ_CHUNK);
+      while (lo < hi) {
+        ssize_t r = pread(fd, dst + lo, hi - lo, position + lo);
+        if (r <= 0) {
+          sptl::die("cannot read %ld bytes at offset %ld", hi - lo, position + lo);
+        }
+        lo += r;
+      }
+    });
+  }
+  // Reads the next bytes of the file into dst
+  void read(char* dst, long bytes) {
+    read_at(dst, bytes, offset);
+    offset += bytes;
+  }
+  void seek(long position) {
+    offset = position;
+  }
+  // Reads the next bytes of the file into seg(0), ..., seg(count - 1),
+  // iovecs that take them in order. Blocks of READ_SEGMENTS segments are
+  // read in parallel, each by preadv, which scatters the bytes of the
+  // block into its segments.
+  template <class Segment>
+  void read_segments(long count, Segment seg) {
+    long blocks = (count + READ_SEGMENTS - 1) / READ_SEGMENTS;
+    parray<long> offsets(blocks + 1);
+    long bytes = graph::csr_offsets(offsets.begin(), blocks, [&] (long b) {
+      long n = 0;
+      for (long i = b * READ_SEGMENTS; i < std::min(count, (b + 1) * READ_SEGMENTS); i++) {
+        n += seg(i).iov_len;
+      }
+      return n;
+    });
+    long base = offset;
+    parallel_for(0l, blocks, [&] (long b) {
+      struct iovec iov[READ_SEGMENTS];
+      long lo = b * READ_SEGMENTS;
+      int k = (int)std::min(count - lo, (long)READ_SEGMENTS);
+      for (int j = 0; j < k; j++) {
+        iov[j] = seg(lo + j);
+      }
+      long position = base + offsets[b];
+      int first = 0;
+      ssize_t r = 0;
+      while (true) {
+        // skips the segments that the last preadv filled
+        while (first < k && (size_t)r >= iov[first].iov_len) {
+          r -= iov[first].iov_len;
+          first++;
+        }
+        if (first == k) {
+          break;
+        }
+        iov[first].iov_base = (char*)iov[first].iov_base + r;
+        iov[first].iov_len -= r;
+        r = preadv(fd, iov + first, k - first, position);
+        if (r <= 0) {
+          sptl::die("cannot read segments at offset %ld", position);
+        }
+        position += r;
+      }
+    });
+    offset += bytes;
+  }
+};
+
+class output_file {
+  int fd;
+  long offset;
+public:
+  output_file(std::string file) : offset(0) {
+    fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      sptl::die("cannot create %s", file.c_str());
+    }
+  }
+  ~output_file() {
+    close(fd);
+  }
+  // Writes src[0, bytes) at [position, position + bytes) in the file
+  void write_at(const char* src, long bytes, long position) {
+    long chunks = (bytes + READ_CHUNK - 1) / READ_CHUNK;
+    parallel_for(0l, chunks, [&] (long c) {
+      long lo = c * READ_CHUNK;
+      long hi = std::min(bytes, lo + READ_CHUNK);
+      while (lo < hi) {
+        ssize_t r = pwrite(fd, src + lo, hi - lo, position + lo);
+        if (r <= 0) {
+          sptl::die("cannot write %ld bytes at offset %ld", hi - lo, position + lo);
+        }
+        lo += r;
+      }
+    });
+  }
+  // Appends src[0, bytes) to the file
+  void write(const char* src, long bytes) {
+    write_at(src, bytes, offset);
+    offset += bytes;
+  }
+  // Appends seg(0), ..., seg(count - 1), iovecs, in order; as for
+  // input_file::read_segments, blocks of READ_SEGMENTS segments are
+  // written in parallel, each by pwritev
+  template <class Segment>
+  void write_segments(long count, Segment seg) {
+    long blocks = (count + READ_SEGMENTS - 1) / READ_SEGMENTS;
+    parray<long> offsets(blocks + 1);
+    long bytes = graph::csr_offsets(offsets.begin(), blocks, [&] (long b) {
+      long n = 0;
+      for (long i = b * READ_SEGMENTS; i < std::min(count, (b + 1) * READ_SEGMENTS); i++) {
+        n += seg(i).iov_len;
+      }
+      return n;
+    });
+    long base = offset;
+    parallel_for(0l, blocks, [&] (long b) {
+      struct iovec iov[READ_SEGMENTS];
+      long lo = b * READ_SEGMENTS;
+      int k = (int)std::min(count - lo, (long)READ_SEGMENTS);
+      for (int j = 0; j < k; j++) {
+        iov[j] = seg(lo + j);
+      }
+      long position = base + offsets[b];
+      int first = 0;
+      ssize_t r = 0;
+      while (true) {
+        // skips the segments that the last pwritev wrote
+        while (first < k && (size_t)r >= iov[first].iov_len) {
+          r -= iov[first].iov_len;
+          first++;
+        }
+        if (first == k) {
+          break;
+        }
+        iov[first].iov_base = (char*)iov[first].iov_base + r;
+        iov[first].iov_len -= r;
+        r = pwritev(fd, iov + first, k - first, position);
+        if (r <= 0) {
+          sptl::die("cannot write segments at offset %ld", position);
+        }
+        position += r;
+      }
+    });
+    offset += bytes;
+  }
+  long tell() const {
+    return offset;
+  }
+};
+
+// ***************************************************************
+//    String pools
+// ***************************************************************
+
+// A string_pool holds its strings in a single arena, each followed by a
+// NUL, rather than in an allocation of its own. The arena positions of
+// the strings come from a prefix sum over their lengths, and
+// read_segments reads the characters straight into them. del frees the
+// whole pool at once.
+struct string_pool {
+  parray<char*> strings;
+  char* arena;
+  string_pool() : arena(NULL) {}
+  void del() {
+    free(arena);
+    arena = NULL;
+    strings.clear();
+  }
+};
+
+// Same, for strings each paired with an int; the pairs lie in a second
+// arena
+struct string_int_pool {
+  parray<std::pair<char*, int>*> items;
+  char* arena;
+  std::pair<char*, int>* pairs;
+  string_int_pool() : arena(NULL), pairs(NULL) {}
+  void del() {
+    free(arena);
+    free(pairs);
+    arena = NULL;
+    pairs = NULL;
+    items.clear();
+  }
+};
+
+static inline struct iovec file_segment(void* base, long len) {
+  struct iovec v;
+  v.iov_base = base;
+  v.iov_len = len;
+  return v;
+}
+
 template <class Item>
-Item read_from_file(std::ifstream& in);
+Item read_from_file(input_file& in);
 
 template <class Item>
 struct read_from_file_struct {
-  Item operator()(std::ifstream& in) const {
+  Item operator()(input_file& in) const {
     Item memory;
     in.read(reinterpret_cast<char*>(&memory), sizeof(Item));
     return memory;
@@ -25,7 +254,7 @@ struct read_from_file_struct {
 
 template <>
 struct read_from_file_struct<std::string> {
-  std::string operator()(std::ifstream& in) const {
+  std::string operator()(input_file& in) const {
     int size = 0;
     in.read(reinterpret_cast<char*>(&size), sizeof(int));
     std::string answer;
@@ -37,7 +266,7 @@ struct read_from_file_struct<std::string> {
 
 template <class Item>
 struct read_from_file_struct<Item*> {
-  Item* operator()(std::ifstream& in, long size) const {
+  Item* operator()(input_file& in, long size) const {
     Item* result = (Item*)malloc(sizeof(Item) * size);
     in.read(reinterpret_cast<char*>(result), sizeof(Item) * size);
     return result;
@@ -46,10 +275,11 @@ struct read_from_file_struct<Item*> {
 
 template <class Item>
 struct read_from_file_struct<parray<Item>> {
-  parray<Item> operator()(std::ifstream& in) const {
+  parray<Item> operator()(input_file& in) const {
     long size = 0;
     in.read(reinterpret_cast<char*>(&size), sizeof(long));
-    parray<Item> result(size);
+    parray<Item> result;
+    result.reset(size);
     in.read(reinterpret_cast<char*>(result.begin()), sizeof(Item) * size);
     return result;
   }
@@ -57,46 +287,124 @@ struct read_from_file_struct<parray<Item>> {
 
 template <>
 struct read_from_file_struct<parray<char*>> {
-  parray<char*> operator()(std::ifstream& in) const {
+  parray<char*> operator()(input_file& in) const {
     long size = 0;
     in.read(reinterpret_cast<char*>(&size), sizeof(long));
+    parray<int> len;
+    len.reset(size);
+    in.read(reinterpret_cast<char*>(len.begin()), sizeof(int) * size);
+    // the strings are read at once, then split
+    parray<long> offsets(size + 1);
+    long bytes = graph::csr_offsets(offsets.begin(), size, [&] (long i) {
+      return len[i];
+    });
+    parray<char> chars;
+    chars.reset(bytes);
+    in.read(chars.begin(), bytes);
     parray<char*> result(size);
-    int* len = new int[size];
-    in.read(reinterpret_cast<char*>(len), sizeof(int) * size);
-    for (int i = 0; i < size; i++) {
+    parallel_for(0l, size, [&] (long i) {
       result[i] = new char[len[i] + 1];
+      std::copy(chars.begin() + offsets[i], chars.begin() + offsets[i + 1], result[i]);
       result[i][len[i]] = 0;
-      in.read(&result[i][0], sizeof(char) * len[i]);
-    }
-    delete [] len;
+    });
     return result;
   }
 };
 
 template <>
 struct read_from_file_struct<parray<std::pair<char*, int>*>> {
-  parray<std::pair<char*, int>*> operator()(std::ifstream& in) const {
+  parray<std::pair<char*, int>*> operator()(input_file& in) const {
     long size = 0;
     in.read(reinterpret_cast<char*>(&size), sizeof(long));
-    int* len = new int[size];
-    in.read(reinterpret_cast<char*>(len), sizeof(int) * size);
+    parray<int> len;
+    len.reset(size);
+    in.read(reinterpret_cast<char*>(len.begin()), sizeof(int) * size);
+    // the strings, each followed by its int, are read at once, then split
+    parray<long> offsets(size + 1);
+    long bytes = graph::csr_offsets(offsets.begin(), size, [&] (long i) {
+      return len[i] + (long)sizeof(int);
+    });
+    parray<char> chars;
+    chars.reset(bytes);
+    in.read(chars.begin(), bytes);
     parray<std::pair<char*, int>*> result(size);
-    for (int i = 0; i < size; i++) {
+    parallel_for(0l, size, [&] (long i) {
+      const char* p = chars.begin() + offsets[i];
       char* f = new char[len[i] + 1];
+      std::copy(p, p + len[i], f);
       f[len[i]] = 0;
-      in.read(f, sizeof(char) * len[i]);
       int s = 0;
-      in.read(reinterpret_cast<char*>(&s), sizeof(int));
+      memcpy(&s, p + len[i], sizeof(int));
       result[i] = new std::pair<char*, int>(f, s);
-    }
-    delete [] len;
+    });
     return result;
   }
 };
 
+// Same file format as parray<char*>
+template <>
+struct read_from_file_struct<string_pool> {
+  string_pool operator()(input_file& in) const {
+    long size = 0;
+    in.read(reinterpret_cast<char*>(&size), sizeof(long));
+    parray<int> len;
+    len.reset(size);
+    in.read(reinterpret_cast<char*>(len.begin()), sizeof(int) * size);
+    parray<long> offsets(size + 1);
+    long bytes = graph::csr_offsets(offsets.begin(), size, [&] (long i) {
+      return len[i] + 1l;
+    });
+    string_pool pool;
+    pool.arena = (char*)malloc(std::max(bytes, 1l));
+    pool.strings.reset(size);
+    parallel_for(0l, size, [&] (long i) {
+      pool.strings[i] = pool.arena + offsets[i];
+      pool.arena[offsets[i] + len[i]] = 0;
+    });
+    in.read_segments(size, [&] (long i) {
+      return file_segment(pool.strings[i], len[i]);
+    });
+    return pool;
+  }
+};
+
+// Same file format as parray<std::pair<char*, int>*>; the ints are read
+// straight into the pairs
+template <>
+struct read_from_file_struct<string_int_pool> {
+  string_int_pool operator()(input_file& in) const {
+    long size = 0;
+    in.read(reinterpret_cast<char*>(&size), sizeof(long));
+    parray<int> len;
+    len.reset(size);
+    in.read(reinterpret_cast<char*>(len.begin()), sizeof(int) * size);
+    parray<long> offsets(size + 1);
+    long bytes = graph::csr_offsets(offsets.begin(), size, [&] (long i) {
+      return len[i] + 1l;
+    });
+    string_int_pool pool;
+    pool.arena = (char*)malloc(std::max(bytes, 1l));
+    pool.pairs = (std::pair<char*, int>*)malloc(sizeof(std::pair<char*, int>) * std::max(size, 1l));
+    pool.items.reset(size);
+    parallel_for(0l, size, [&] (long i) {
+      pool.pairs[i].first = pool.arena + offsets[i];
+      pool.arena[offsets[i] + len[i]] = 0;
+      pool.items[i] = pool.pairs + i;
+    });
+    in.read_segments(2 * size, [&] (long j) {
+      long i = j / 2;
+      if (j % 2 == 0) {
+        return file_segment(pool.pairs[i].first, len[i]);
+      }
+      return file_segment(&pool.pairs[i].second, sizeof(int));
+    });
+    return pool;
+  }
+};
+
 template <class Point>
 struct read_from_file_struct<triangles<Point>> {
-  triangles<Point> operator()(std::ifstream& in) const {
+  triangles<Point> operator()(input_file& in) const {
     triangles<Point> t;
     in.read(reinterpret_cast<char*>(&t.num_points), sizeof(long));
     t.p = read_from_file_struct<Point*>()(in, t.num_points);
@@ -107,25 +415,90 @@ struct read_from_file_struct<triangles<Point>> {
 
 template <class intT>
 struct read_from_file_struct<graph::graph<intT>> {
-  graph::graph<intT> operator()(std::ifstream& in) {
+  graph::graph<intT> operator()(input_file& in) {
     intT n, m;
     in.read(reinterpret_cast<char*>(&n), sizeof(intT));
     in.read(reinterpret_cast<char*>(&m), sizeof(intT));
-    intT* degree = new intT[n];
-    in.read(reinterpret_cast<char*>(degree), sizeof(intT) * n);
+    parray<intT> degree;
+    degree.reset(n);
+    in.read(reinterpret_cast<char*>(degree.begin()), sizeof(intT) * n);
     intT* e = (intT*)malloc(sizeof(intT) * m);
     in.read(reinterpret_cast<char*>(e), sizeof(intT) * m);
+    long* offsets = (long*)malloc(sizeof(long) * ((long)n + 1));
+    graph::csr_offsets(offsets, n, [&] (intT i) {
+      return degree[i];
+    });
     graph::vertex<intT>* v = (graph::vertex<intT>*)malloc(sizeof(graph::vertex<intT>) * n);
-    int offset = 0;
-    for (int i = 0; i < n; i++) {
-      v[i] = graph::vertex<intT>(e + offset, degree[i]);
-      offset += degree[i];
-    }
-    delete [] degree;
+    parallel_for((intT)0, n, [&] (intT i) {
+      v[i] = graph::vertex<intT>(e + offsets[i], degree[i]);
+    });
+    free(offsets);
     return graph::graph<intT>(v, n, m, e);
   }
 };
 
+// Same file format as graph::graph; the offsets are computed by a
+// parallel scan of the degrees
+template <class intT>
+struct read_from_file_struct<graph::csr_graph<intT>> {
+  graph::csr_graph<intT> operator()(input_file& in) {
+    intT n, m;
+    in.read(reinterpret_cast<char*>(&n), sizeof(intT));
+    in.read(reinterpret_cast<char*>(&m), sizeof(intT));
+    parray<intT> degrees;
+    degrees.reset(n);
+    in.read(reinterpret_cast<char*>(degrees.begin()), sizeof(intT) * n);
+    long* offsets = (long*)malloc(sizeof(long) * ((long)n + 1));
+    long total = graph::csr_offsets(offsets, n, [&] (intT i) {
+      return degrees[i];
+    });
+    intT* e = (intT*)malloc(sizeof(intT) * total);
+    in.read(reinterpret_cast<char*>(e), sizeof(intT) * total);
+    return graph::csr_graph<intT>(offsets, e, n, total);
+  }
+};
+
+// Maps the graph in file, in the format above, without copying its
+// edges: the edges of the csr_graph point into a private mapping of the
+// file, which pages them in on first access, or all at once if populate
+// is set; advice is passed to madvise. Only the offsets are allocated,
+// by a parallel scan of the degrees.
+template <class intT>
+graph::csr_graph<intT> map_csr_graph(std::string file, bool populate, int advice) {
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    sptl::die("cannot open %s", file.c_str());
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < (long)(2 * sizeof(intT))) {
+    sptl::die("cannot read the size of %s", file.c_str());
+  }
+  long bytes = st.st_size;
+  // private and writable, so that the graph can be updated in place,
+  // e.g. by to_byte_graph, without writing back to the file
+  char* mapped = (char*)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    sptl::die("cannot map %s", file.c_str());
+  }
+  madvise(mapped, bytes, advice);
+  intT* header = (intT*)mapped;
+  intT n = header[0];
+  intT* degrees = header + 2;
+  // the degrees must be in the file before they are scanned
+  if (n < 0 || (long)sizeof(intT) * (2 + (long)n) > bytes) {
+    sptl::die("truncated graph %s", file.c_str());
+  }
+  long* offsets = (long*)malloc(sizeof(long) * ((long)n + 1));
+  long total = graph::csr_offsets(offsets, n, [&] (intT i) {
+    return degrees[i];
+  });
+  if ((long)sizeof(intT) * (2 + (long)n + total) > bytes) {
+    sptl::die("truncated graph %s", file.c_str());
+  }
+  return graph::csr_graph<intT>(offsets, degrees + n, n, total, mapped, bytes);
+}
+
 class ray_cast_test {
 public:
   static
@@ -157,7 +530,7 @@ ray_cast_test ray_cast_test::foo;
 
 template <>
 struct read_from_file_struct<ray_cast_test> {
-  ray_cast_test operator()(std::ifstream& in) {
+  ray_cast_test operator()(input_file& in) {
     ray_cast_test test;
   
     test.points = read_from_file<parray<point3d>>(in);
@@ -169,13 +542,13 @@ struct read_from_file_struct<ray_cast_test> {
 };
   
 template <class Item>
-Item read_from_file(std::ifstream& in) {
+Item read_from_file(input_file& in) {
   return read_from_file_struct<Item>()(in);
 }
 
 template <class Item>
 Item read_from_file(std::string file) {
-  std::ifstream in(file, std::ifstream::binary);
+  input_file in(file);
   return read_from_file<Item>(in);
 }
   
@@ -5,13 +5,25 @@
 #include <algorithm>
 
 #include "bench.hpp"
+#include "externalsort.hpp"
 
 #include "samplesort.hpp"
+#include "stringsort.hpp"
+#include "sort.hpp"
 #include "sampleSort.h"
 
 template <class Item>
 using parray = sptl::parray<Item>;
 
+template <class Item>
+void string_specialized_sort(parray<Item>& x) {
+  sptl::die("string_specialized requires -type string");
+}
+
+void string_specialized_sort(parray<char*>& x) {
+  sptl::string_sort(x.begin(), (int)x.size());
+}
+
 template <class Item, class Compare>
 void benchmark(sptl::bench::measured_type measured,
                parray<Item>& x,
@@ -21,6 +33,21 @@ void benchmark(sptl::bench::measured_type measured,
   if (should_check) {
     ref = x;
   }
+  auto check = [&] (bool stable) {
+    if (! should_check) {
+      return;
+    }
+    std::stable_sort(ref.begin(), ref.end(), compare);
+    auto it_ref = ref.begin();
+    for (auto it = x.begin(); it != x.end(); it++) {
+      bool ok = stable ? *it == *it_ref : ! (compare(*it, *it_ref) || compare(*it_ref, *it));
+      if (! ok) {
+        std::cerr << "bogus result" << std::endl;
+        exit(0);
+      }
+      it_ref++;
+    }
+  };
   deepsea::cmdline::dispatcher d;
   d.add("pbbs", [&] {
     measured([&] {
@@ -28,54 +55,104 @@ void benchmark(sptl::bench::measured_type measured,
     });
   });
   d.add("sptl", [&] {
+    bool stable = false;
+    deepsea::cmdline::dispatcher a;
+    a.add("default", [&] {
+      measured([&] {
+        sptl::sample_sort(x.begin(), (int)x.size(), compare);
+      });
+    });
+    a.add("workspace", [&] {
+      sptl::sample_sort_workspace<Item, int> ws((int)x.size());
+      measured([&] {
+        sptl::sample_sort(x.begin(), (int)x.size(), compare, ws);
+      });
+    });
+    a.add("stable", [&] {
+      stable = true;
+      measured([&] {
+        sptl::stable_sample_sort(x.begin(), (int)x.size(), compare);
+      });
+    });
+    a.add("stable_workspace", [&] {
+      stable = true;
+      sptl::sample_sort_workspace<Item, int> ws((int)x.size());
+      measured([&] {
+        sptl::stable_sample_sort(x.begin(), (int)x.size(), compare, ws);
+      });
+    });
+    // picks the engine from the input, and reports it
+    a.add("adaptive", [&] {
+      sptl::sort_engine engine;
+      measured([&] {
+        engine = sptl::sort(x.begin(), (int)x.size(), compare);
+      });
+      printf("engine %s\n", sptl::sort_engine_name(engine));
+    });
+    // leaf kernels alone, applied to the whole input
+    a.add("quick_sort", [&] {
+      measured([&] {
+        sptl::quick_sort(x.begin(), (int)x.size(), compare);
+      });
+    });
+    a.add("block_quick_sort", [&] {
+      measured([&] {
+        sptl::block_quick_sort(x.begin(), (int)x.size(), compare);
+      });
+    });
+    a.dispatch_or_default("algo", "default");
+    sptl::bench::write_outfile(x);
+    check(stable);
+  });
+  d.add("string_specialized", [&] {
     measured([&] {
-     sptl::sample_sort(x.begin(), (int)x.size(), compare);
+      string_specialized_sort(x);
     });
-    if (should_check) {
-      std::sort(ref.begin(), ref.end());
-      auto it_ref = ref.begin();
-      for (auto it = x.begin(); it != x.end(); it++) {
-        if (*it != *it_ref) {
-          std::cerr << "bogus result" << std::endl;
-          exit(0);
-        }
-        it_ref++;
-      }
-    }
+    sptl::bench::write_outfile(x);
+    check(false);
   });
   d.dispatch("library");
 }
 
-template <class Item, class Compare, class Destroy>
-void benchmark(sptl::bench::measured_type measured,
-               const Compare& compare,
-               const Destroy& destroy) {
+std::string read_infile() {
   std::string infile = deepsea::cmdline::parse_or_default_string("infile", "");
   if (infile == "") {
     sptl::die("missing infile");
   }
-  parray<Item> x = sptl::read_from_file<parray<Item>>(infile);
+  return infile;
+}
+
+template <class Item, class Compare>
+void benchmark(sptl::bench::measured_type measured,
+               const Compare& compare) {
+  // with -external, the input is sorted out of core
+  if (deepsea::cmdline::parse_or_default_bool("external", false)) {
+    sptl::bench::external_sort_benchmark<Item>(measured, [&] (Item* a, long n) {
+      // a run can hold more than 2^31 elements
+      sptl::sample_sort(a, n, compare);
+    }, compare);
+    return;
+  }
+  parray<Item> x = sptl::read_from_file<parray<Item>>(read_infile());
   benchmark(measured, x, compare);
-  destroy(x);
 }
 
 int main(int argc, char** argv) {
   sptl::bench::launch(argc, argv, [&] (sptl::bench::measured_type measured) {
     deepsea::cmdline::dispatcher d;
     d.add("double", [&] {
-      benchmark<double>(measured, std::less<double>(), [] (parray<double>& xs) { });
+      benchmark<double>(measured, std::less<double>());
     });
     d.add("int", [&]  {
-      benchmark<int>(measured, std::less<int>(), [] (parray<int>& xs) { });
+      benchmark<int>(measured, std::less<int>());
     });
+    // the strings lie in the arena of a pool, which is freed at once
     d.add("string", [&]  {
-      benchmark<char*>(measured, [&] (char* a, char* b) {
-          return std::strcmp(a, b) < 0;
-        }, [] (parray<char*>& xs) {
-          for (int i = 0; i < xs.size(); i++) {
-            delete [] xs[i];
-          }
-        });
+      sptl::string_pool pool = sptl::read_from_file<sptl::string_pool>(read_infile());
+      benchmark(measured, pool.strings, [&] (char* a, char* b) {
+        return std::strcmp(a, b) < 0;
+      });
+      pool.del();
     });
     d.dispatch("type");
   });
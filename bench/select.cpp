@@ -0,0 +1,103 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "bench.hpp"
+
+#include "select.hpp"
+#include "samplesort.hpp"
+
+template <class Item>
+using parray = sptl::parray<Item>;
+
+// Selects the element of rank -k among the -n random items, or the -k
+// smallest items; k defaults to n / 2
+template <class Item>
+void benchmark(sptl::bench::measured_type measured) {
+  bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
+  long n = deepsea::cmdline::parse_or_default_long("n", 10000000);
+  long k = deepsea::cmdline::parse_or_default_long("k", n / 2);
+  k = std::max(1l, std::min(k, n));
+  parray<Item> x(n, [&] (long i) {
+    return sptl::hash<Item>(i);
+  });
+  auto compare = std::less<Item>();
+  parray<Item> ref;
+  if (should_check) {
+    ref = x;
+    std::sort(ref.begin(), ref.end());
+  }
+  // checks that y[0, k) holds the k smallest items, sorted or not
+  auto check_smallest = [&] (Item* y, bool sorted) {
+    if (! should_check) {
+      return;
+    }
+    parray<Item> z(k, [&] (long i) {
+      return y[i];
+    });
+    if (! sorted) {
+      std::sort(z.begin(), z.end());
+    }
+    for (long i = 0; i < k; i++) {
+      if (z[i] != ref[i]) {
+        sptl::die("bogus result at position %ld", i);
+      }
+    }
+  };
+  deepsea::cmdline::dispatcher d;
+  d.add("select_kth", [&] {
+    Item r;
+    measured([&] {
+      r = sptl::select_kth(x.begin(), n, k - 1, compare);
+    });
+    sptl::bench::write_outfile(r);
+    if (should_check && r != ref[k - 1]) {
+      sptl::die("bogus result");
+    }
+  });
+  d.add("top_k", [&] {
+    parray<Item> y;
+    measured([&] {
+      y = sptl::top_k(x.begin(), n, k, compare);
+    });
+    sptl::bench::write_outfile(y);
+    check_smallest(y.begin(), false);
+  });
+  d.add("partial_sort", [&] {
+    measured([&] {
+      sptl::partial_sort(x.begin(), n, k, compare);
+    });
+    sptl::bench::write_outfile(x);
+    check_smallest(x.begin(), true);
+  });
+  // baselines
+  d.add("sample_sort", [&] {
+    measured([&] {
+      sptl::sample_sort(x.begin(), n, compare);
+    });
+    sptl::bench::write_outfile(x);
+    check_smallest(x.begin(), true);
+  });
+  d.add("nth_element", [&] {
+    measured([&] {
+      std::nth_element(x.begin(), x.begin() + (k - 1), x.end(), compare);
+    });
+    sptl::bench::write_outfile(x);
+    check_smallest(x.begin(), false);
+  });
+  d.dispatch_or_default("algo", "select_kth");
+}
+
+int main(int argc, char** argv) {
+  sptl::bench::launch(argc, argv, [&] (sptl::bench::measured_type measured) {
+    deepsea::cmdline::dispatcher d;
+    d.add("double", [&] {
+      benchmark<double>(measured);
+    });
+    d.add("int", [&] {
+      benchmark<int>(measured);
+    });
+    d.dispatch_or_default("type", "double");
+  });
+}
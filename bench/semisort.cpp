@@ -0,0 +1,115 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <unordered_set>
+
+#include "bench.hpp"
+
+#include "semisort.hpp"
+#include "blockradixsort.hpp"
+
+template <class Item>
+using parray = sptl::parray<Item>;
+
+template <class Item>
+struct key_of {
+  static int get(const Item& x) {
+    return x;
+  }
+  static Item make(int k, long i) {
+    return k;
+  }
+};
+
+template <>
+struct key_of<std::pair<int, int>> {
+  static int get(const std::pair<int, int>& x) {
+    return x.first;
+  }
+  static std::pair<int, int> make(int k, long i) {
+    return std::make_pair(k, (int)i);
+  }
+};
+
+// -n items, whose keys among -keys follow a Zipfian distribution of
+// exponent -zipf: key k has probability proportional to 1 / (k + 1)^zipf.
+// With -sparse, the keys are scattered over 31 bits, as identifiers are
+template <class Item>
+parray<Item> zipfian_items() {
+  long n = deepsea::cmdline::parse_or_default_long("n", 10000000);
+  long m = deepsea::cmdline::parse_or_default_long("keys", n / 100 + 1);
+  double s = deepsea::cmdline::parse_or_default_double("zipf", 1.0);
+  bool sparse = deepsea::cmdline::parse_or_default_bool("sparse", true);
+  parray<double> cdf(m, [&] (long k) {
+    return 1.0 / pow((double)(k + 1), s);
+  });
+  double total = sptl::dps::scan(cdf.begin(), cdf.end(), 0.0, [&] (double x, double y) {
+    return x + y;
+  }, cdf.begin(), sptl::forward_inclusive_scan);
+  return parray<Item>(n, [&] (long i) {
+    double u = sptl::hash<double>(i) * total;
+    long k = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    k = std::min(k, m - 1);
+    if (sparse) {
+      k = sptl::hashi((unsigned int)k) & 0x7fffffff;
+    }
+    return key_of<Item>::make((int)k, i);
+  });
+}
+
+template <class Item>
+void benchmark(sptl::bench::measured_type measured) {
+  bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
+  parray<Item> x = zipfian_items<Item>();
+  int n = (int)x.size();
+  deepsea::cmdline::dispatcher d;
+  d.add("semisort", [&] {
+    measured([&] {
+      sptl::semisort(x.begin(), n, [&] (const Item& y) {
+        return key_of<Item>::get(y);
+      });
+    });
+  });
+  d.add("integer_sort", [&] {
+    measured([&] {
+      sptl::integer_sort(x.begin(), n);
+    });
+  });
+  d.dispatch_or_default("algo", "semisort");
+  sptl::bench::write_outfile(x);
+  if (should_check) {
+    // the keys must come in runs, one per key
+    std::unordered_set<int> done;
+    for (int i = 0; i < n; i++) {
+      int k = key_of<Item>::get(x[i]);
+      if (i > 0 && k == key_of<Item>::get(x[i - 1])) {
+        continue;
+      }
+      if (! done.insert(k).second) {
+        sptl::die("bogus result at position %d", i);
+      }
+    }
+    parray<Item> y = zipfian_items<Item>();
+    std::sort(y.begin(), y.end());
+    std::sort(x.begin(), x.end());
+    for (int i = 0; i < n; i++) {
+      if (x[i] != y[i]) {
+        sptl::die("bogus result: not a permutation of the input");
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  sptl::bench::launch(argc, argv, [&] (sptl::bench::measured_type measured) {
+    deepsea::cmdline::dispatcher d;
+    d.add("int", [&] {
+      benchmark<int>(measured);
+    });
+    d.add("pair_int_int", [&] {
+      benchmark<std::pair<int, int>>(measured);
+    });
+    d.dispatch_or_default("type", "int");
+  });
+}
@@ -18,6 +18,7 @@ void benchmark(sptl::bench::measured_type measured) {
     sptl::die("missing infile");
   }
   sptl::graph::graph<intT> x = sptl::read_from_file<sptl::graph::graph<intT>>(infile);
+  sptl::bench::reorder(x);
   sptl::graph::edgeArray<intT> edges = to_edge_array(x);
   bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
   parray<intT> sptl_results;
@@ -38,6 +39,7 @@ void benchmark(sptl::bench::measured_type measured) {
     measured([&] {
       sptl_results = sptl::spanningTree(edges);
     });
+    sptl::bench::write_outfile(sptl_results);
     if (should_check) {
       do_pbbs();
       for (intT i = 0; i < sptl_results.size(); i++) {
@@ -35,6 +35,7 @@ void benchmark(sptl::bench::measured_type measured) {
     measured([&] {
       sptl_result = sptl::suffix_array(&x[0], x.length());
     });
+    sptl::bench::write_outfile(sptl_result);
     if (should_check) {
       do_pbbs();
       for (auto i = 0; i < x.length(); i++) {
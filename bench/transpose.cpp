@@ -0,0 +1,102 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "bench.hpp"
+
+#include "transpose.hpp"
+
+template <class Item>
+using parray = sptl::parray<Item>;
+
+// Transposes a -rows x -cols matrix, or, for block_transpose, moves
+// segments of -segment elements on average from row-major to
+// column-major order, as done by sample_sort and radix sort
+template <class Item>
+void benchmark(sptl::bench::measured_type measured) {
+  bool should_check = deepsea::cmdline::parse_or_default_bool("check", false);
+  long rows = deepsea::cmdline::parse_or_default_long("rows", 4000);
+  long cols = deepsea::cmdline::parse_or_default_long("cols", 4000);
+  long m = rows * cols;
+  deepsea::cmdline::dispatcher d;
+  d.add("transpose", [&] {
+    parray<Item> a(m, [&] (long i) {
+      return (Item)i;
+    });
+    // touch the output, so that page faults are not measured
+    parray<Item> b(m, [&] (long i) {
+      return (Item)0;
+    });
+    measured([&] {
+      sptl::transpose(a.begin(), b.begin(), rows, cols);
+    });
+    sptl::bench::write_outfile(b);
+    if (should_check) {
+      for (long i = 0; i < rows; i++) {
+        for (long j = 0; j < cols; j++) {
+          if (b[j * rows + i] != a[i * cols + j]) {
+            sptl::die("bogus item at position %ld", j * rows + i);
+          }
+        }
+      }
+    }
+  });
+  d.add("block_transpose", [&] {
+    long segment = deepsea::cmdline::parse_or_default_long("segment", 2);
+    parray<long> lengths(m, [&] (long i) {
+      return (long)(sptl::hashi(i) % (2 * segment + 1));
+    });
+    parray<long> offset_a;
+    offset_a.reset(m);
+    long n = sptl::dps::scan(lengths.begin(), lengths.end(), 0l, [&] (long x, long y) {
+      return x + y;
+    }, offset_a.begin(), sptl::forward_exclusive_scan);
+    parray<long> offset_b;
+    offset_b.reset(m);
+    sptl::transpose(lengths.begin(), offset_b.begin(), rows, cols);
+    sptl::dps::scan(offset_b.begin(), offset_b.end(), 0l, [&] (long x, long y) {
+      return x + y;
+    }, offset_b.begin(), sptl::forward_exclusive_scan);
+    parray<Item> a(n, [&] (long i) {
+      return (Item)i;
+    });
+    parray<Item> b(n, [&] (long i) {
+      return (Item)0;
+    });
+    measured([&] {
+      sptl::block_transpose(a.begin(), b.begin(), offset_a.begin(), offset_b.begin(),
+                            lengths.begin(), rows, cols);
+    });
+    sptl::bench::write_outfile(b);
+    if (should_check) {
+      for (long i = 0; i < rows; i++) {
+        for (long j = 0; j < cols; j++) {
+          long k = i * cols + j;
+          for (long l = 0; l < lengths[k]; l++) {
+            if (b[offset_b[j * rows + i] + l] != a[offset_a[k] + l]) {
+              sptl::die("bogus item at position %ld", offset_b[j * rows + i] + l);
+            }
+          }
+        }
+      }
+    }
+  });
+  d.dispatch_or_default("algo", "transpose");
+}
+
+int main(int argc, char** argv) {
+  sptl::bench::launch(argc, argv, [&] (sptl::bench::measured_type measured) {
+    deepsea::cmdline::dispatcher d;
+    d.add("int", [&] {
+      benchmark<int>(measured);
+    });
+    d.add("long", [&] {
+      benchmark<long>(measured);
+    });
+    d.add("double", [&] {
+      benchmark<double>(measured);
+    });
+    d.dispatch_or_default("type", "int");
+  });
+}
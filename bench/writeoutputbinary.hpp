@@ -0,0 +1,167 @@
+
+#include <string>
+#include <cstring>
+#include <utility>
+
+#include "readinputbinary.hpp"
+
+#ifndef _PBBS_SPTL_WRITEOUTPUTBINARY
+#define _PBBS_SPTL_WRITEOUTPUTBINARY
+
+namespace sptl {
+
+// ***************************************************************
+//    Binary output
+// ***************************************************************
+
+// write_to_file writes each type in the format that read_from_file
+// reads. Large payloads go through output_file, which writes them by
+// parallel chunks, and arrays of strings or of neighbor lists through
+// output_file::write_segments, which gathers them without a copy.
+
+template <class Item>
+void write_to_file(output_file& out, const Item& x);
+
+template <class Item>
+struct write_to_file_struct {
+  void operator()(output_file& out, const Item& x) const {
+    out.write(reinterpret_cast<const char*>(&x), sizeof(Item));
+  }
+};
+
+template <>
+struct write_to_file_struct<std::string> {
+  void operator()(output_file& out, const std::string& x) const {
+    int size = (int)x.size();
+    out.write(reinterpret_cast<const char*>(&size), sizeof(int));
+    out.write(x.data(), size);
+  }
+};
+
+template <class Item>
+struct write_to_file_struct<Item*> {
+  void operator()(output_file& out, const Item* x, long size) const {
+    out.write(reinterpret_cast<const char*>(x), sizeof(Item) * size);
+  }
+};
+
+template <class Item>
+struct write_to_file_struct<parray<Item>> {
+  void operator()(output_file& out, const parray<Item>& x) const {
+    long size = x.size();
+    out.write(reinterpret_cast<const char*>(&size), sizeof(long));
+    out.write(reinterpret_cast<const char*>(x.begin()), sizeof(Item) * size);
+  }
+};
+
+template <>
+struct write_to_file_struct<parray<char*>> {
+  void operator()(output_file& out, const parray<char*>& x) const {
+    long size = x.size();
+    out.write(reinterpret_cast<const char*>(&size), sizeof(long));
+    parray<int> len(size, [&] (long i) {
+      return (int)strlen(x[i]);
+    });
+    out.write(reinterpret_cast<const char*>(len.begin()), sizeof(int) * size);
+    out.write_segments(size, [&] (long i) {
+      return file_segment(x[i], len[i]);
+    });
+  }
+};
+
+template <>
+struct write_to_file_struct<parray<std::pair<char*, int>*>> {
+  void operator()(output_file& out, const parray<std::pair<char*, int>*>& x) const {
+    long size = x.size();
+    out.write(reinterpret_cast<const char*>(&size), sizeof(long));
+    parray<int> len(size, [&] (long i) {
+      return (int)strlen(x[i]->first);
+    });
+    out.write(reinterpret_cast<const char*>(len.begin()), sizeof(int) * size);
+    out.write_segments(2 * size, [&] (long j) {
+      long i = j / 2;
+      if (j % 2 == 0) {
+        return file_segment(x[i]->first, len[i]);
+      }
+      return file_segment(&x[i]->second, sizeof(int));
+    });
+  }
+};
+
+template <>
+struct write_to_file_struct<string_pool> {
+  void operator()(output_file& out, const string_pool& x) const {
+    write_to_file(out, x.strings);
+  }
+};
+
+template <>
+struct write_to_file_struct<string_int_pool> {
+  void operator()(output_file& out, const string_int_pool& x) const {
+    write_to_file(out, x.items);
+  }
+};
+
+template <class Point>
+struct write_to_file_struct<triangles<Point>> {
+  void operator()(output_file& out, const triangles<Point>& t) const {
+    out.write(reinterpret_cast<const char*>(&t.num_points), sizeof(long));
+    write_to_file_struct<Point*>()(out, t.p, t.num_points);
+    out.write(reinterpret_cast<const char*>(&t.num_triangles), sizeof(long));
+    write_to_file_struct<triangle*>()(out, t.t, t.num_triangles);
+  }
+};
+
+// The neighbor lists of the vertices need not be contiguous
+template <class intT>
+struct write_to_file_struct<graph::graph<intT>> {
+  void operator()(output_file& out, const graph::graph<intT>& G) const {
+    out.write(reinterpret_cast<const char*>(&G.n), sizeof(intT));
+    out.write(reinterpret_cast<const char*>(&G.m), sizeof(intT));
+    parray<intT> degree(G.n, [&] (intT i) {
+      return G.V[i].degree;
+    });
+    out.write(reinterpret_cast<const char*>(degree.begin()), sizeof(intT) * G.n);
+    out.write_segments(G.n, [&] (long i) {
+      return file_segment(G.V[i].Neighbors, sizeof(intT) * G.V[i].degree);
+    });
+  }
+};
+
+template <class intT>
+struct write_to_file_struct<graph::csr_graph<intT>> {
+  void operator()(output_file& out, const graph::csr_graph<intT>& G) const {
+    intT m = (intT)G.m;
+    out.write(reinterpret_cast<const char*>(&G.n), sizeof(intT));
+    out.write(reinterpret_cast<const char*>(&m), sizeof(intT));
+    parray<intT> degree(G.n, [&] (intT i) {
+      return G.degree(i);
+    });
+    out.write(reinterpret_cast<const char*>(degree.begin()), sizeof(intT) * G.n);
+    out.write(reinterpret_cast<const char*>(G.edges), sizeof(intT) * G.m);
+  }
+};
+
+template <>
+struct write_to_file_struct<ray_cast_test> {
+  void operator()(output_file& out, const ray_cast_test& test) const {
+    write_to_file(out, test.points);
+    write_to_file(out, test.triangles);
+    write_to_file(out, test.rays);
+  }
+};
+
+template <class Item>
+void write_to_file(output_file& out, const Item& x) {
+  write_to_file_struct<Item>()(out, x);
+}
+
+template <class Item>
+void write_to_file(std::string file, const Item& x) {
+  output_file out(file);
+  write_to_file(out, x);
+}
+
+} // end namespace
+
+#endif
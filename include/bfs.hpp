@@ -41,72 +41,443 @@ namespace sptl {
 
 struct nonNegF{bool operator() (int a) {return (a>=0);}};
 
-std::pair<int,int> bfs(int start, graph::graph<int> graph) {
-  int numVertices = graph.n;
-  int numEdges = graph.m;
-  graph::vertex<int>* g = graph.V;
-  parray<int> frontier;
-  frontier.reset(numEdges);
-  parray<int> visited(numVertices, 0);
-  parray<int> frontier_next;
-  frontier_next.reset(numEdges);
+// Number of frontier edges that a task of a top-down round scans
+#define BFS_CHUNK 2048
+
+// Writes the exclusive scan of the degrees of frontier[0, frontier_size)
+// into offsets; returns their sum. Edge counts are 64 bits wide, as the
+// offsets of csr_graph are
+template <class Graph>
+long bfs_frontier_offsets(const Graph& g, const int* frontier, int frontier_size, long* offsets) {
+  parallel_for(0, frontier_size, [&] (int i) {
+    offsets[i] = g.degree(frontier[i]);
+  });
+  return dps::scan(offsets, offsets + frontier_size, 0l, [&] (long x, long y) { return x + y; }, offsets, forward_exclusive_scan);
+}
+
+// Scratch space of bfs_top_down, which the rounds of a search reuse; it
+// grows to the largest number of frontier edges of a round
+struct bfs_scratch {
+  parray<int> claimed;
   parray<int> counts;
-  counts.reset(numVertices);
-  
+
+  void reserve(long nr) {
+    if (claimed.size() >= nr) {
+      return;
+    }
+    claimed.reset(nr);
+    counts.reset((nr + BFS_CHUNK - 1) / BFS_CHUNK);
+  }
+};
+
+// Top-down round: tries to claim each neighbor of frontier[0,
+// frontier_size) by claim(v, ngh), and replaces the frontier by the
+// claimed vertices; offsets and nr are as filled by bfs_frontier_offsets.
+// The nr edges are cut into chunks of BFS_CHUNK, even within a vertex,
+// and each chunk writes its claimed vertices into its slot of the
+// scratch space, of one int per edge; a scan of their numbers then
+// concatenates the slots. The scratch space is thus proportional to the
+// edges of the largest frontier, rather than to those of the graph.
+// Returns the size of the next frontier.
+template <class Graph, class Claim>
+int bfs_top_down(const Graph& g, int* frontier, int frontier_size, const long* offsets, long nr,
+                 bfs_scratch& scratch, Claim claim) {
+  long chunks = (nr + BFS_CHUNK - 1) / BFS_CHUNK;
+  scratch.reserve(nr);
+  int* claimed = scratch.claimed.begin();
+  int* counts = scratch.counts.begin();
+  parallel_for(0l, chunks, [&] (long c) {
+    long lo = c * BFS_CHUNK;
+    long hi = std::min(nr, lo + BFS_CHUNK);
+    int* slot = claimed + lo;
+    int k = 0;
+    // the frontier vertex of edge lo
+    int i = (int)(std::upper_bound(offsets, offsets + frontier_size, lo) - offsets) - 1;
+    for (long e = lo; e < hi; i++) {
+      int v = frontier[i];
+      int end = (int)std::min((long)g.degree(v), hi - offsets[i]);
+      g.map_neighbors(v, (int)(e - offsets[i]), end, [&] (int j, int ngh) {
+        if (claim(v, ngh)) {
+          slot[k++] = ngh;
+        }
+        return true;
+      });
+      e = offsets[i] + end;
+    }
+    counts[c] = k;
+  });
+  int frontier_next_size = dps::scan(counts, counts + chunks, 0, [&] (int x, int y) { return x + y; }, counts, forward_exclusive_scan);
+  parallel_for(0l, chunks, [&] (long c) {
+    int size = ((c + 1 < chunks) ? counts[c + 1] : frontier_next_size) - counts[c];
+    std::copy(claimed + c * BFS_CHUNK, claimed + c * BFS_CHUNK + size, frontier + counts[c]);
+  });
+  return frontier_next_size;
+}
+
+// Visited vertices are marked in a bitmap. The BFS functions take a
+// graph::csr_graph or a graph::byte_graph
+template <class Graph>
+std::pair<int,int> bfs(int start, const Graph& g) {
+  int n = g.n;
+  parray<graph::bitmap_wordT> visited(graph::bitmap_words(n), (graph::bitmap_wordT)0);
+  auto visited_ptr = visited.begin();
+  parray<int> frontier;
+  frontier.reset(n);
+  parray<long> offsets;
+  offsets.reset(n);
+  bfs_scratch scratch;
+
   frontier[0] = start;
   int frontier_size = 1;
-  visited[start] = 1;
+  graph::bitmap_claim(visited_ptr, start);
 
   int total_visited = 0;
   int round = 0;
-  auto visited_ptr = visited.begin();
-  auto frontier_ptr = frontier.begin();
-  auto frontier_next_ptr = frontier_next.begin();
-  auto counts_ptr = counts.begin();
 
   while (frontier_size > 0) {
     round++;
     total_visited += frontier_size;
-    parallel_for(0, frontier_size, [&] (int l, int r) { return r - l; }, [&, counts_ptr, g, frontier_ptr] (int i) {
-      counts_ptr[i] = g[frontier_ptr[i]].degree;
-    }, [&, counts_ptr, g, frontier_ptr] (int l, int r) {
-      for (int i = l; i < r; i++) {
-        counts_ptr[i] = g[frontier[i]].degree;
-      }
+    long nr = bfs_frontier_offsets(g, frontier.begin(), frontier_size, offsets.begin());
+    frontier_size = bfs_top_down(g, frontier.begin(), frontier_size, offsets.begin(), nr, scratch, [&] (int v, int ngh) {
+      return graph::bitmap_claim(visited_ptr, ngh);
     });
-    int nr = dps::scan(counts.begin(), counts.begin() + frontier_size, 0, [&] (int x, int y) { return x + y; }, counts.begin(), forward_exclusive_scan);
-    parallel_for(0, frontier_size, [&] (int l, int r) { return (r == frontier_size ? nr : counts_ptr[r]) - counts_ptr[l] + (r - l); }, [&, frontier_next_ptr, frontier_ptr, g, visited_ptr] (int i) {
-       int k = 0;
-       int v = frontier_ptr[i];
-       int o = counts_ptr[i];
-       for (int j = 0; j < g[v].degree; j++) {
-         int ngh = g[v].Neighbors[j];
-           if (visited_ptr[ngh] == 0 && !__sync_val_compare_and_swap(&visited_ptr[ngh], 0, 1)) {//utils::CAS(&visited_ptr[ngh], 0, 1)) {
-             frontier_next_ptr[o + j] = /*g[v].Neighbors[k++] = */ ngh;
-           }
-         else frontier_next_ptr[o + j] = -1;}
-       //g[v].degree = k;
-     }, [&, frontier_next_ptr, frontier_ptr, g, visited_ptr] (int l, int r) {
-       for (int i = l; i < r; i++) {
-         int k = 0;
-         int v = frontier_ptr[i];
-         int o = counts_ptr[i];
-
-        for (int j = 0; j < g[v].degree; j++) {
-          int ngh = g[v].Neighbors[j];
-          if (visited_ptr[ngh] == 0 && !__sync_val_compare_and_swap(&visited_ptr[ngh], 0, 1)) {
-            frontier_next_ptr[o + j] = /*g[v].Neighbors[k++] = */ ngh;
-          }
-          else frontier_next_ptr[o + j] = -1;
-        }
-        //g[v].degree = k;
+  }
+  return std::pair<int, int>(total_visited, round);
+}
+  
+// **************************************************************
+//    DIRECTION-OPTIMIZING BREADTH FIRST SEARCH
+// **************************************************************
+
+// Following Beamer et al., each round expands the frontier either top
+// down, scanning the edges of the frontier vertices, or bottom up,
+// scanning the unvisited vertices for a neighbor in the frontier, which
+// is then held as a bitmap. Rounds switch to bottom up when the edges of
+// the frontier exceed 1 / BFS_ALPHA of the unexplored edges, and back to
+// top down when the frontier holds fewer than 1 / BFS_BETA of the
+// vertices. Bottom-up rounds follow edges backwards, so the graph must
+// be symmetric, as the graphs of PBBS are.
+
+#define BFS_ALPHA 15
+#define BFS_BETA 18
+
+// A vertex is visited once it has a parent: parents[v] is -1 until a
+// frontier vertex claims v by a CAS, which also records the BFS tree.
+// If levels is not NULL, the claiming round also writes the level of v.
+
+// Claims ngh for v by a CAS on the parent of ngh
+static inline bool bfs_claim_parent(int* parents, int* levels, int level, int v, int ngh) {
+  if (parents[ngh] < 0 && __sync_bool_compare_and_swap(&parents[ngh], -1, v)) {
+    if (levels != NULL) {
+      levels[ngh] = level;
+    }
+    return true;
+  }
+  return false;
+}
+
+// Bottom-up round: each unvisited vertex looks for a neighbor in the
+// frontier bits, which becomes its parent, and joins next if it finds
+// one. Each word of next is computed by one task, so no atomics are
+// needed. counts and edges receive, for each word, the number of
+// vertices that joined and the sum of their degrees.
+template <class Graph>
+void bfs_bottom_up(const Graph& g, int* parents, int* levels, int level,
+                                 const graph::bitmap_wordT* bits, graph::bitmap_wordT* next, int* counts, long* edges) {
+  int n = g.n;
+  int words = graph::bitmap_words(n);
+  parallel_for(0, words, [&] (int l, int r) {
+    return g.cost(l * BITMAP_WORD_BITS, std::min(n, r * BITMAP_WORD_BITS)) + (r - l);
+  }, [&] (int w) {
+    int lo = w * BITMAP_WORD_BITS;
+    int hi = std::min(n, lo + BITMAP_WORD_BITS);
+    graph::bitmap_wordT word = 0;
+    int count = 0;
+    long degrees = 0;
+    for (int v = lo; v < hi; v++) {
+      if (parents[v] >= 0) {
+        continue;
       }
+      g.map_neighbors(v, 0, g.degree(v), [&] (int j, int ngh) {
+        if (! graph::bitmap_get(bits, ngh)) {
+          return true;
+        }
+        parents[v] = ngh;
+        if (levels != NULL) {
+          levels[v] = level;
+        }
+        word |= (graph::bitmap_wordT)1 << (v - lo);
+        count++;
+        degrees += g.degree(v);
+        return false;
+      });
+    }
+    next[w] = word;
+    counts[w] = count;
+    edges[w] = degrees;
+  });
+}
+
+// Sets the bits of the vertices of frontier[0, frontier_size)
+static inline void bfs_sparse_to_bitmap(const int* frontier, int frontier_size, graph::bitmap_wordT* bits, int words) {
+  sptl::fill(bits, bits + words, (graph::bitmap_wordT)0);
+  parallel_for(0, frontier_size, [&] (int i) {
+    int v = frontier[i];
+    __sync_fetch_and_or(&bits[v / BITMAP_WORD_BITS], (graph::bitmap_wordT)1 << (v % BITMAP_WORD_BITS));
+  });
+}
+
+// Writes the vertices whose bits are set into frontier, in order;
+// counts holds the exclusive scan of the number of bits of each word
+static inline void bfs_bitmap_to_sparse(const graph::bitmap_wordT* bits, int words, const int* counts, int* frontier) {
+  parallel_for(0, words, [&] (int w) {
+    int o = counts[w];
+    for (graph::bitmap_wordT word = bits[w]; word != 0; word &= word - 1) {
+      frontier[o++] = w * BITMAP_WORD_BITS + __builtin_ctzl(word);
+    }
+  });
+}
+
+// Returns the number of vertices reached from start and the number of
+// rounds, as bfs does. Fills parents[0, n) with the BFS tree, where the
+// parent of start is start and that of an unreached vertex is -1, and
+// levels[0, n), if not NULL, with the distances from start (-1 if
+// unreached).
+template <class Graph>
+std::pair<int,int> bfs_direction_optimizing(int start, const Graph& g, int* parents, int* levels) {
+  int n = g.n;
+  long m = g.m;
+  int words = graph::bitmap_words(n);
+  sptl::fill(parents, parents + n, -1);
+  if (levels != NULL) {
+    sptl::fill(levels, levels + n, -1);
+    levels[start] = 0;
+  }
+  parray<int> frontier;
+  frontier.reset(n);
+  parray<long> offsets;
+  offsets.reset(n);
+  bfs_scratch scratch;
+  parray<graph::bitmap_wordT> bits;
+  bits.reset(words);
+  parray<graph::bitmap_wordT> bits_next;
+  bits_next.reset(words);
+  parray<int> word_counts;
+  word_counts.reset(words);
+  parray<long> word_edges;
+  word_edges.reset(words);
+  graph::bitmap_wordT* bits_ptr = bits.begin();
+  graph::bitmap_wordT* bits_next_ptr = bits_next.begin();
+
+  frontier[0] = start;
+  int frontier_size = 1;
+  long frontier_edges = g.degree(start);
+  parents[start] = start;
+  // whether the frontier is in bits, rather than in frontier
+  bool bottom_up = false;
+  long unexplored = m;
+
+  int total_visited = 0;
+  int round = 0;
+  auto plus = [&] (int x, int y) { return x + y; };
+
+  while (frontier_size > 0) {
+    round++;
+    total_visited += frontier_size;
+    if (bottom_up && frontier_size < n / BFS_BETA) {
+      parallel_for(0, words, [&] (int w) {
+        word_counts[w] = __builtin_popcountl(bits_ptr[w]);
+      });
+      dps::scan(word_counts.begin(), word_counts.end(), 0, plus, word_counts.begin(), forward_exclusive_scan);
+      bfs_bitmap_to_sparse(bits_ptr, words, word_counts.begin(), frontier.begin());
+      bottom_up = false;
+    }
+    long nr = 0;
+    if (! bottom_up) {
+      nr = bfs_frontier_offsets(g, frontier.begin(), frontier_size, offsets.begin());
+      frontier_edges = nr;
+    }
+    unexplored -= frontier_edges;
+    if (! bottom_up && frontier_edges > unexplored / BFS_ALPHA) {
+      bfs_sparse_to_bitmap(frontier.begin(), frontier_size, bits_ptr, words);
+      bottom_up = true;
+    }
+    if (bottom_up) {
+      bfs_bottom_up(g, parents, levels, round, bits_ptr, bits_next_ptr, word_counts.begin(), word_edges.begin());
+      std::swap(bits_ptr, bits_next_ptr);
+      frontier_size = level1::reduce(word_counts.begin(), word_counts.end(), 0, plus, [&] (int c) { return c; });
+      frontier_edges = level1::reduce(word_edges.begin(), word_edges.end(), 0l, [&] (long x, long y) {
+        return x + y;
+      }, [&] (long e) { return e; });
+    } else {
+      frontier_size = bfs_top_down(g, frontier.begin(), frontier_size, offsets.begin(), nr, scratch, [&] (int v, int ngh) {
+        return bfs_claim_parent(parents, levels, round, v, ngh);
+      });
+    }
+  }
+  return std::pair<int, int>(total_visited, round);
+}
+
+template <class Graph>
+std::pair<int,int> bfs_direction_optimizing(int start, const Graph& g) {
+  parray<int> parents;
+  parents.reset(g.n);
+  return bfs_direction_optimizing(start, g, parents.begin(), NULL);
+}
+
+// Top-down BFS that also fills parents and levels, as
+// bfs_direction_optimizing does
+template <class Graph>
+std::pair<int,int> bfs(int start, const Graph& g, int* parents, int* levels) {
+  int n = g.n;
+  sptl::fill(parents, parents + n, -1);
+  if (levels != NULL) {
+    sptl::fill(levels, levels + n, -1);
+    levels[start] = 0;
+  }
+  parray<int> frontier;
+  frontier.reset(n);
+  parray<long> offsets;
+  offsets.reset(n);
+  bfs_scratch scratch;
+  frontier[0] = start;
+  int frontier_size = 1;
+  parents[start] = start;
+  int total_visited = 0;
+  int round = 0;
+  while (frontier_size > 0) {
+    round++;
+    total_visited += frontier_size;
+    long nr = bfs_frontier_offsets(g, frontier.begin(), frontier_size, offsets.begin());
+    frontier_size = bfs_top_down(g, frontier.begin(), frontier_size, offsets.begin(), nr, scratch, [&] (int v, int ngh) {
+      return bfs_claim_parent(parents, levels, round, v, ngh);
     });
-    // Filter out the empty slots (marked with -1)
-    frontier_size = dps::filter(frontier_next.begin(), frontier_next.begin() + nr, frontier.begin(), [&] (int v) { return v >= 0; });
   }
   return std::pair<int, int>(total_visited, round);
 }
+
+// **************************************************************
+//    MULTI-SOURCE BREADTH FIRST SEARCH
+// **************************************************************
+
+// Following MS-BFS (Then et al.), a batch of up to MSBFS_SOURCES
+// searches traverses the graph together: each vertex carries a bitset of
+// the searches that have seen it and of those whose frontier holds it,
+// so an edge is scanned once per round for all the searches of the
+// batch. The rounds are top-down rounds over the vertices that are in
+// the frontier of at least one search.
+
+#define MSBFS_SOURCES 64
+// Vertices whose bitsets a task counts at the end of a batch
+#define MSBFS_BLOCK 8192
+
+typedef graph::bitmap_wordT msbfs_setT;
+
+// Scratch space of multi_source_bfs, which successive batches reuse
+struct msbfs_workspace {
+  // searches that have seen each vertex
+  parray<msbfs_setT> seen;
+  // searches whose frontier holds each vertex, for the current and the
+  // next round; visit is valid only for the vertices of frontier
+  parray<msbfs_setT> visit;
+  parray<msbfs_setT> next;
+  parray<int> frontier;
+  parray<long> offsets;
+  bfs_scratch scratch;
+
+  void reset(int n) {
+    if (seen.size() == n) {
+      return;
+    }
+    seen.reset(n);
+    visit.reset(n);
+    next.reset(n);
+    sptl::fill(next.begin(), next.end(), (msbfs_setT)0);
+    frontier.reset(n);
+    offsets.reset(n);
+  }
+};
+
+// Runs the searches from sources[0, k), with k <= MSBFS_SOURCES, and
+// writes into results[i] what bfs(sources[i], graph) returns
+template <class Graph>
+void multi_source_bfs_batch(const int* sources, int k, const Graph& g,
+                            std::pair<int,int>* results, msbfs_workspace& ws) {
+  int n = g.n;
+  ws.reset(n);
+  msbfs_setT* seen = ws.seen.begin();
+  msbfs_setT* visit = ws.visit.begin();
+  msbfs_setT* next = ws.next.begin();
+  int* frontier = ws.frontier.begin();
+  sptl::fill(seen, seen + n, (msbfs_setT)0);
+  int frontier_size = 0;
+  for (int i = 0; i < k; i++) {
+    int s = sources[i];
+    if (seen[s] == 0) {
+      frontier[frontier_size++] = s;
+    }
+    seen[s] |= (msbfs_setT)1 << i;
+    results[i] = std::pair<int, int>(0, 0);
+  }
+  for (int i = 0; i < frontier_size; i++) {
+    visit[frontier[i]] = seen[frontier[i]];
+  }
+  msbfs_setT active = k == MSBFS_SOURCES ? ~(msbfs_setT)0 : ((msbfs_setT)1 << k) - 1;
+  while (frontier_size > 0) {
+    // the searches whose frontier is not empty do one more round
+    for (int i = 0; i < k; i++) {
+      results[i].second += (active >> i) & 1;
+    }
+    long nr = bfs_frontier_offsets(g, frontier, frontier_size, ws.offsets.begin());
+    // ngh joins the next frontier of the searches that reach it through v
+    // and have not seen it; the first of the claims adds it to frontier
+    frontier_size = bfs_top_down(g, frontier, frontier_size, ws.offsets.begin(), nr, ws.scratch, [&] (int v, int ngh) {
+      msbfs_setT bits = visit[v] & ~seen[ngh] & ~next[ngh];
+      if (bits == 0) {
+        return false;
+      }
+      return __sync_fetch_and_or(&next[ngh], bits) == 0;
+    });
+    parallel_for(0, frontier_size, [&] (int i) {
+      int u = frontier[i];
+      visit[u] = next[u];
+      seen[u] |= next[u];
+      next[u] = 0;
+    });
+    active = level1::reduce(frontier, frontier + frontier_size, (msbfs_setT)0, [&] (msbfs_setT x, msbfs_setT y) {
+      return x | y;
+    }, [&] (int u) {
+      return visit[u];
+    });
+  }
+  // the number of vertices that each search has seen
+  int blocks = (n + MSBFS_BLOCK - 1) / MSBFS_BLOCK;
+  parray<int> counts(blocks * MSBFS_SOURCES, 0);
+  parallel_for(0, blocks, [&] (int b) {
+    int* c = counts.begin() + b * MSBFS_SOURCES;
+    int hi = std::min(n, (b + 1) * MSBFS_BLOCK);
+    for (int v = b * MSBFS_BLOCK; v < hi; v++) {
+      for (msbfs_setT bits = seen[v]; bits != 0; bits &= bits - 1) {
+        c[__builtin_ctzl(bits)]++;
+      }
+    }
+  });
+  for (int b = 0; b < blocks; b++) {
+    for (int i = 0; i < k; i++) {
+      results[i].first += counts[b * MSBFS_SOURCES + i];
+    }
+  }
+}
+
+// Runs a BFS from each of sources[0, k), by batches of MSBFS_SOURCES,
+// and writes into results[i] what bfs(sources[i], graph) returns
+template <class Graph>
+void multi_source_bfs(const int* sources, int k, const Graph& g, std::pair<int,int>* results) {
+  msbfs_workspace ws;
+  for (int i = 0; i < k; i += MSBFS_SOURCES) {
+    multi_source_bfs_batch(sources + i, std::min(MSBFS_SOURCES, k - i), g, results + i, ws);
+  }
+}
   
 } //end namespace
 
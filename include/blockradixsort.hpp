@@ -1,4 +1,8 @@
 
+#include <type_traits>
+#include <cstdint>
+
+#include "quicksort.hpp"
 #include "transpose.hpp"
 
 #ifndef _PBBS_SPTL_BLOCKRADIXSORT
@@ -16,8 +20,7 @@ namespace intsort {
 typedef unsigned char bIndexT;
 
 template <class E, class F, class intT>
-void radix_block(E* a, E* b, bIndexT* tmp, intT counts[BUCKETS], intT offsets[BUCKETS],
-                intT offset_b, intT n, intT max_value, F extract) {
+void radix_block_count(E* a, bIndexT* tmp, intT counts[BUCKETS], intT n, intT max_value, F extract) {
   for (intT i = 0; i < max_value; i++) {
     counts[i] = 0;
   }
@@ -25,6 +28,11 @@ void radix_block(E* a, E* b, bIndexT* tmp, intT counts[BUCKETS], intT offsets[BU
     intT k = tmp[j] = extract(a[j]);
     counts[k]++;
   }
+}
+
+template <class E, class intT>
+void radix_block_scatter(E* a, E* b, bIndexT* tmp, intT counts[BUCKETS], intT offsets[BUCKETS],
+                         intT offset_b, intT n, intT max_value) {
   intT s = offset_b;
   for (intT i = 0; i < max_value; i++) {
     s += counts[i];
@@ -36,10 +44,38 @@ void radix_block(E* a, E* b, bIndexT* tmp, intT counts[BUCKETS], intT offsets[BU
   }
 }
 
+template <class E, class F, class intT>
+void radix_block(E* a, E* b, bIndexT* tmp, intT counts[BUCKETS], intT offsets[BUCKETS],
+                intT offset_b, intT n, intT max_value, F extract) {
+  radix_block_count(a, tmp, counts, n, max_value, extract);
+  radix_block_scatter(a, b, tmp, counts, offsets, offset_b, n, max_value);
+}
+
+// If all n elements fall in bucket k, sets offsets to the bucket
+// offsets (0 up to k, n after) and returns true
+template <class intT>
+bool single_bucket(intT* counts, intT* offsets, intT n, intT max_value) {
+  intT k = 0;
+  while (k < max_value && counts[k] == 0) {
+    k++;
+  }
+  if (k == max_value || counts[k] != n) {
+    return false;
+  }
+  for (intT i = 0; i < max_value; i++) {
+    offsets[i] = (i <= k) ? 0 : n;
+  }
+  return true;
+}
+
 template <class E, class F, class intT>
 void radix_step_serial(E* a, E* b, bIndexT* tmp, intT buckets[BUCKETS],
                      intT n, intT max_value, F extract) {
-  radix_block(a, b, tmp, buckets, buckets, (intT)0, n, max_value, extract);
+  radix_block_count(a, tmp, buckets, n, max_value, extract);
+  if (single_bucket(buckets, buckets, n, max_value)) {
+    return;
+  }
+  radix_block_scatter(a, b, tmp, buckets, buckets, (intT)0, n, max_value);
   for (intT i = 0; i < n; i++) {
     a[i] = b[i];
   }
@@ -55,6 +91,8 @@ void radix_step_serial(E* a, E* b, bIndexT* tmp, intT buckets[BUCKETS],
 // max_value is the number of buckets per set (m <= BUCKETS)
 // extract is a function that extract the appropriate bits from A
 //  it must return a non-negative integer less than m
+// if all elements fall in a single bucket, the pass stops after counting:
+//  A is left as it is, and B is not written
 template <class E, class F, class intT>
 void radix_step(E* a, E* b, bIndexT *tmp, intT (*raw_buckets)[BUCKETS],
                intT raw_buckets_number, intT n, intT max_value, bool top, F extract) {
@@ -74,7 +112,7 @@ void radix_step(E* a, E* b, bIndexT *tmp, intT (*raw_buckets)[BUCKETS],
   parallel_for(intT(0), blocks_number, [&] (intT i) {
     intT offset = i * block_length;
     intT current_block_length = i == blocks_number - 1 ? n - offset : block_length;
-    radix_block(a + offset, b, tmp + offset, cnts + max_value * i, offsets_b + max_value * i, offset, current_block_length, max_value, extract);
+    radix_block_count(a + offset, tmp + offset, cnts + max_value * i, current_block_length, max_value, extract);
   });
   
   transpose(cnts, offsets_a, blocks_number, max_value);
@@ -83,6 +121,22 @@ void radix_step(E* a, E* b, bIndexT *tmp, intT (*raw_buckets)[BUCKETS],
   dps::scan(offsets_a, offsets_a + blocks_number * max_value, id, [&] (intT x, intT y) {
     return x + y;
   }, offsets_a, forward_exclusive_scan);
+  // if there is only one bucket, the pass is skipped before any element
+  // moves
+  for (intT j = 0; j < max_value; j++) {
+    intT next = (j == max_value - 1) ? n : offsets_a[(j + 1) * blocks_number];
+    if (next - offsets_a[j * blocks_number] == n) {
+      for (intT i = 0; i < max_value; i++) {
+        raw_buckets[0][i] = (i <= j) ? 0 : n;
+      }
+      return;
+    }
+  }
+  parallel_for(intT(0), blocks_number, [&] (intT i) {
+    intT offset = i * block_length;
+    intT current_block_length = i == blocks_number - 1 ? n - offset : block_length;
+    radix_block_scatter(a + offset, b, tmp + offset, cnts + max_value * i, offsets_b + max_value * i, offset, current_block_length, max_value);
+  });
   block_transpose(b, a, offsets_b, offsets_a, cnts, blocks_number, max_value);
   // put the offsets for each bucket in the first bucket set of raw_buckets
   for (intT j = 0; j < max_value; j++) {
@@ -91,21 +145,34 @@ void radix_step(E* a, E* b, bIndexT *tmp, intT (*raw_buckets)[BUCKETS],
 }
 
 // a function to extract "bits" bits starting at bit location "offset"
+// the key returned by f can be wider than intT, only the digit must fit
 template <class intT, class E, class F>
 struct eBits {
-  F _f;  intT _mask;  intT _offset;
+  F _f;  intT _mask;  int _offset;
 
-  eBits(int bits, intT offset, F f): _mask((1 << bits) - 1), _offset(offset), _f(f) {}
+  eBits(int bits, int offset, F f): _f(f), _mask(((intT)1 << bits) - 1), _offset(offset) {}
 
   intT operator() (E p) {
-    return _mask & (_f(p) >> _offset);
+    return _mask & (intT) (_f(p) >> _offset);
   }
 };
 
+// Mask of the bits of the keys that are not known to be the same in all keys
+typedef unsigned long varyingT;
+#define ALL_VARYING (~(varyingT)0)
+
+// returns true if the digit of "bits" bits at "offset" can differ among the keys
+static inline bool digit_varies(varyingT varying, int bits, int offset) {
+  return ((varying >> offset) & ((((varyingT)1) << bits) - 1)) != 0;
+}
+
 // Radix sort with low order bits first
+// passes on digits that are the same in all keys, according to varying,
+// are skipped
 template <class E, class F, class intT>
 void radix_loop_bottom_up(E* a, E* b, bIndexT* tmp, intT (*raw_buckets)[BUCKETS],
-                       intT raw_buckets_number, intT n, int bits, bool top, F f) {
+                       intT raw_buckets_number, intT n, int bits, bool top, F f,
+                       varyingT varying = ALL_VARYING) {
   int rounds = (bits + MAX_RADIX - 1) / MAX_RADIX;
   int bits_per_round = (bits + rounds - 1) / rounds;
   int bit_offset = 0;
@@ -113,8 +180,10 @@ void radix_loop_bottom_up(E* a, E* b, bIndexT* tmp, intT (*raw_buckets)[BUCKETS]
     if (bit_offset + bits_per_round > bits) {
       bits_per_round = bits - bit_offset;
     }
-    radix_step(a, b, tmp, raw_buckets, raw_buckets_number, n, (intT)1 << bits_per_round, top,
-              eBits<intT, E, F>(bits_per_round, bit_offset, f));
+    if (digit_varies(varying, bits_per_round, bit_offset)) {
+      radix_step(a, b, tmp, raw_buckets, raw_buckets_number, n, (intT)1 << bits_per_round, top,
+                eBits<intT, E, F>(bits_per_round, bit_offset, f));
+    }
     bit_offset += bits_per_round;
   }
 }
@@ -131,7 +200,7 @@ void radix_loop_top_down(E* a, E* b, bIndexT* tmp, intT (*raw_buckets)[BUCKETS],
               eBits<intT, E, F>(MAX_RADIX, bits - MAX_RADIX, f));
     intT* offsets = raw_buckets[0];
     intT remain = raw_buckets_number - BUCKETS - 1;
-    float y = remain / (float) n;
+    double y = remain / (double) n;
     auto comp = [&] (intT l, intT r) {
       return (r == BUCKETS ? n : offsets[r]) - offsets[l];
     };
@@ -158,6 +227,104 @@ long integer_sort_space(intT n) {
   return sizeof(E) * n + sizeof(bIndexT) * n + sizeof(bucketsT) * blocks_number;
 }
 
+// Fills bucket_offsets (of length max_value) from the sorted array a,
+// as described for integer_sort below
+template <class E, class F, class intT>
+void fill_bucket_offsets(E* a, intT* bucket_offsets, intT n, intT max_value, F f) {
+  sptl::fill(bucket_offsets, bucket_offsets + max_value, n);
+  {
+    auto comp = [&] (intT lo, intT hi) {
+      return (hi - lo) * sizeof(E);
+    };
+    parallel_for(intT(0), n - 1, comp, [&] (intT i) {
+      intT v = f(a[i]);
+      intT vn = f(a[i + 1]);
+      if (v != vn) {
+        bucket_offsets[vn] = i + 1;
+      }
+    });
+  }
+  bucket_offsets[f(a[0])] = 0;
+  dps::scan(bucket_offsets, bucket_offsets + max_value, n, [&] (intT x, intT y) {
+    return std::min(x, y);
+  }, bucket_offsets, backward_inclusive_scan);
+}
+
+// Computes in one pass the OR and the AND of the keys f(a[i]). Returns
+// the mask of the bits that differ in some keys, which is 0 if all keys
+// are equal.
+template <class E, class F, class intT>
+varyingT varying_bits(E* a, intT n, F f) {
+  std::pair<varyingT, varyingT> id(0, ALL_VARYING);
+  auto or_and = level1::reduce(a, a + n, id, [&] (std::pair<varyingT, varyingT> x, std::pair<varyingT, varyingT> y) {
+    return std::make_pair(x.first | y.first, x.second & y.second);
+  }, [&] (E x) {
+    varyingT k = (varyingT) f(x);
+    return std::make_pair(k, k);
+  });
+  return or_and.first ^ or_and.second;
+}
+
+// returns the position of the lowest set bit of a nonzero varying mask
+static inline int lowest_varying(varyingT varying) {
+  int low = 0;
+  while (((varying >> low) & 1) == 0) {
+    low++;
+  }
+  return low;
+}
+
+// the key of f shifted right by "offset" bits
+template <class E, class F>
+struct shifted_key {
+  typedef typename std::decay<decltype(std::declval<F&>()(std::declval<E&>()))>::type keyT;
+  F _f;  int _offset;
+
+  shifted_key(int offset, F f): _f(f), _offset(offset) {}
+
+  keyT operator() (E p) {
+    return _f(p) >> _offset;
+  }
+};
+
+// Sorts a[0, n) on the low "bits" bits of the keys given by f, using
+// tmp_space as scratch (integer_sort_space bytes). If the sort is done
+// in a single step, returns the offset of each of the 1 << bits buckets,
+// which lives in tmp_space; otherwise returns NULL. When more than one
+// step is needed, bits that are the same in all keys are not sorted on.
+template <class E, class F, class intT>
+intT* radix_sort(E* a, intT n, int bits, bool bottom_up, char* tmp_space, F f) {
+
+  typedef intT bucketsT[BUCKETS];
+
+  intT raw_buckets_number = 1 + n / (BUCKETS * 8);
+
+  // the temporary space is broken into 3 parts: B, Tmp and raw_buckets
+  E* b = (E*) tmp_space;
+  long b_size = sizeof(E) * (long) n;
+  bIndexT* tmp = (bIndexT*) (tmp_space + b_size); // one byte per item
+  long tmp_size = sizeof(bIndexT) * (long) n;
+  bucketsT* raw_buckets = (bucketsT*) (tmp_space + b_size + tmp_size);
+  if (bits <= MAX_RADIX) {
+    radix_step(a, b, tmp, raw_buckets, raw_buckets_number, n, (intT) 1 << bits, true, eBits<intT, E, F>(bits, 0, f));
+    return raw_buckets[0];
+  }
+  // only the range of bits that are not the same in all keys is sorted on
+  varyingT varying = varying_bits(a, n, f);
+  if (varying == 0) {
+    return NULL;
+  }
+  int low = lowest_varying(varying);
+  shifted_key<E, F> g(low, f);
+  bits = utils::bitWidth(varying) - low;
+  if (bottom_up) {
+    radix_loop_bottom_up(a, b, tmp, raw_buckets, raw_buckets_number, n, bits, true, g, varying >> low);
+  } else {
+    radix_loop_top_down(a, b, tmp, raw_buckets, raw_buckets_number, n, bits, g);
+  }
+  return NULL;
+}
+
 // Sorts the array A, which is of length n.
 // Function f maps each element into an integer in the range [0,max_value)
 // If bucketOffsets is not NULL then it should be an array of length max_value
@@ -167,48 +334,15 @@ long integer_sort_space(intT n) {
 template <class E, class F, class intT>
 void integer_sort(E *a, intT* bucket_offsets, intT n, intT max_value, bool bottom_up,
            char* tmp_space, F f) {
-  
-  typedef intT bucketsT[BUCKETS];
-  
   int bits = utils::log2Up(max_value);
-  intT raw_buckets_number = 1 + n / (BUCKETS * 8);
-  
-  // the temporary space is broken into 3 parts: B, Tmp and raw_buckets
-  E* b = (E*) tmp_space;
-  intT b_size = sizeof(E) * n;
-  bIndexT* tmp = (bIndexT*) (tmp_space + b_size); // one byte per item
-  intT tmp_size = sizeof(bIndexT) * n;
-  bucketsT* raw_buckets = (bucketsT*) (tmp_space + b_size + tmp_size);
-  if (bits <= MAX_RADIX) {
-    radix_step(a, b, tmp, raw_buckets, raw_buckets_number, n, (intT) 1 << bits, true, eBits<intT, E, F>(bits, 0, f));
-    if (bucket_offsets != NULL) {
-      sptl::copy(raw_buckets[0], raw_buckets[0] + max_value, bucket_offsets);
-    }
+  intT* offsets = radix_sort(a, n, bits, bottom_up, tmp_space, f);
+  if (bucket_offsets == NULL) {
     return;
-  } else if (bottom_up) {
-    radix_loop_bottom_up(a, b, tmp, raw_buckets, raw_buckets_number, n, bits, true, f);
-  } else {
-    radix_loop_top_down(a, b, tmp, raw_buckets, raw_buckets_number, n, bits, f);
   }
-  // Filling offsets array
-  if (bucket_offsets != NULL) {
-    sptl::fill(bucket_offsets, bucket_offsets + max_value, n);
-    {
-      auto comp = [&] (intT lo, intT hi) {
-        return (hi - lo) * sizeof(E);
-      };
-      parallel_for(intT(0), n - 1, comp, [&] (intT i) {
-        intT v = f(a[i]);
-        intT vn = f(a[i + 1]);
-        if (v != vn) {
-          bucket_offsets[vn] = i + 1;
-        }
-      });
-    }
-    bucket_offsets[f(a[0])] = 0;
-    dps::scan(bucket_offsets, bucket_offsets + max_value, n, [&] (intT x, intT y) {
-      return std::min(x, y);
-    }, bucket_offsets, backward_inclusive_scan);
+  if (offsets != NULL) {
+    sptl::copy(offsets, offsets + max_value, bucket_offsets);
+  } else {
+    fill_bucket_offsets(a, bucket_offsets, n, max_value, f);
   }
 }
 
@@ -235,18 +369,403 @@ template <class E, class F, class intT>
 void integer_sort_bottom_up(E* a, intT n, intT max_value, F f) {
   integer_sort(a, (intT*) NULL, n, max_value, true, f);
 }
-  
+
+// Versions that take the number of key bits instead of a bound on the
+// keys, so that keys of all 64 bits can be sorted. Only the digits of
+// the keys are converted to intT.
+template <class E, class F, class intT>
+void integer_sort_bits(E* a, intT n, int bits, bool bottom_up, F f) {
+  long x = integer_sort_space<E, intT>(n);
+  parray<char> s;
+  s.reset(x);
+  radix_sort(a, n, bits, bottom_up, s.begin(), f);
+}
+
+template <class E, class F, class intT>
+void integer_sort_bits(E* a, intT n, int bits, F f) {
+  integer_sort_bits(a, n, bits, false, f);
+}
+
+// **************************************************************
+//    IN-PLACE MSD RADIX SORT
+// **************************************************************
+
+// Segments at most this long are finished with insertion sort
+#define INPLACE_ISORT 32
+
+// Groups the elements of a[0, n) by extract(a[i]) in increasing order,
+// without a scratch copy of the input. extract must return a
+// non-negative integer less than max_value <= BUCKETS. On return,
+// offsets[i] is the position of the first element of bucket i, for
+// i in [0, max_value], with offsets[max_value] = n.
+//
+// The permutation proceeds in rounds, following PARADIS. The unplaced
+// region of each bucket is split into parts, and each part of the
+// array moves elements American-flag style into the same part of
+// other buckets, independently of the other parts. An element whose
+// target part is full stays where it is. A repair step then moves the
+// elements that landed in their own bucket to the front of the
+// unplaced region of that bucket. A round with a single part places
+// all remaining elements, and it is used once the remainder is small
+// or a round places less than half of the remaining elements.
+template <class E, class F, class intT>
+void radix_step_in_place(E* a, intT n, intT max_value, intT* offsets, F extract) {
+  intT expand = (intT) (sizeof(E) <= 4 ? 64 : 32);
+  intT parts = std::min((intT)BUCKETS, 1 + n / (BUCKETS * expand));
+  intT part_length = (n + parts - 1) / parts;
+  // one bucket set per part, used for the counts and then for the heads
+  parray<intT> heads;
+  heads.reset(parts * max_value);
+  parray<intT> tails;
+  tails.reset(parts * max_value);
+  auto comp = [&] (intT lo, intT hi) {
+    return (hi - lo) * (part_length + max_value);
+  };
+  parallel_for(intT(0), parts, comp, [&] (intT i) {
+    intT* cnts = heads.begin() + i * max_value;
+    for (intT k = 0; k < max_value; k++) {
+      cnts[k] = 0;
+    }
+    intT lo = std::min(n, i * part_length);
+    intT hi = std::min(n, lo + part_length);
+    for (intT j = lo; j < hi; j++) {
+      cnts[extract(a[j])]++;
+    }
+  });
+  intT s = 0;
+  for (intT k = 0; k < max_value; k++) {
+    offsets[k] = s;
+    for (intT i = 0; i < parts; i++) {
+      s += heads[i * max_value + k];
+    }
+  }
+  offsets[max_value] = n;
+  for (intT k = 0; k < max_value; k++) {
+    if (offsets[k + 1] - offsets[k] == n) {
+      return;
+    }
+  }
+  // [begin[k], offsets[k + 1]) is the unplaced region of bucket k
+  parray<intT> begin(max_value, [&] (intT k) {
+    return offsets[k];
+  });
+  intT* end = offsets + 1;
+  intT remaining = n;
+  bool stalled = false;
+  while (remaining > 0) {
+    intT p = (stalled || remaining < BUCKETS * expand) ? 1 : parts;
+    parallel_for(intT(0), p, [&] (intT lo, intT hi) { return (hi - lo) * (remaining / p + max_value); }, [&] (intT i) {
+      intT* ph = heads.begin() + i * max_value;
+      intT* pt = tails.begin() + i * max_value;
+      for (intT k = 0; k < max_value; k++) {
+        long len = end[k] - begin[k];
+        ph[k] = begin[k] + (intT)(len * i / p);
+        pt[k] = begin[k] + (intT)(len * (i + 1) / p);
+      }
+      for (intT k = 0; k < max_value; k++) {
+        while (ph[k] < pt[k]) {
+          intT d = extract(a[ph[k]]);
+          if (d == k) {
+            ph[k]++;
+          } else if (ph[d] < pt[d]) {
+            std::swap(a[ph[k]], a[ph[d]]);
+            ph[d]++;
+          } else {
+            // the part of bucket d is full: leave the element for the repair step
+            ph[k]++;
+          }
+        }
+      }
+    });
+    if (p == 1) {
+      break;
+    }
+    parallel_for(intT(0), max_value, [&] (intT lo, intT hi) { return end[hi - 1] - begin[lo] + (hi - lo); }, [&] (intT k) {
+      intT l = begin[k];
+      intT r = end[k];
+      while (true) {
+        while (l < r && extract(a[l]) == k) {
+          l++;
+        }
+        while (l < r && extract(a[r - 1]) != k) {
+          r--;
+        }
+        if (l >= r) {
+          break;
+        }
+        std::swap(a[l], a[r - 1]);
+      }
+      begin[k] = l;
+    });
+    intT unplaced = 0;
+    for (intT k = 0; k < max_value; k++) {
+      unplaced += end[k] - begin[k];
+    }
+    stalled = unplaced > remaining / 2;
+    remaining = unplaced;
+  }
+}
+
+// Radix sort with high order bits first, permuting within a
+template <class E, class F, class intT>
+void radix_loop_top_down_in_place(E* a, intT n, int bits, F f) {
+  if (n <= INPLACE_ISORT) {
+    insertion_sort(a, n, [&] (E x, E y) {
+      return f(x) < f(y);
+    });
+    return;
+  }
+  intT offsets[BUCKETS + 1];
+  if (bits <= MAX_RADIX) {
+    radix_step_in_place(a, n, (intT)1 << bits, offsets, eBits<intT, E, F>(bits, 0, f));
+    return;
+  }
+  radix_step_in_place(a, n, (intT)BUCKETS, offsets, eBits<intT, E, F>(MAX_RADIX, bits - MAX_RADIX, f));
+  auto comp = [&] (intT l, intT r) {
+    return offsets[r] - offsets[l];
+  };
+  parallel_for(intT(0), intT(BUCKETS), comp, [&] (intT i) {
+    radix_loop_top_down_in_place(a + offsets[i], offsets[i + 1] - offsets[i], bits - MAX_RADIX, f);
+  });
+}
+
+// Tag that selects the in-place radix sort. The sort is not stable,
+// but its scratch space does not depend on n.
+struct in_place {};
+
+template <class E, class F, class intT>
+void integer_sort_bits(E* a, intT n, int bits, in_place, F f) {
+  if (bits <= MAX_RADIX) {
+    radix_loop_top_down_in_place(a, n, bits, f);
+    return;
+  }
+  varyingT varying = varying_bits(a, n, f);
+  if (varying == 0) {
+    return;
+  }
+  int low = lowest_varying(varying);
+  radix_loop_top_down_in_place(a, n, utils::bitWidth(varying) - low, shifted_key<E, F>(low, f));
+}
+
+template <class E, class F, class intT>
+void integer_sort(E* a, intT* bucket_offsets, intT n, intT max_value, in_place tag, F f) {
+  integer_sort_bits(a, n, utils::log2Up(max_value), tag, f);
+  if (bucket_offsets != NULL) {
+    fill_bucket_offsets(a, bucket_offsets, n, max_value, f);
+  }
+}
+
+template <class E, class F, class intT>
+void integer_sort(E* a, intT n, intT max_value, in_place tag, F f) {
+  integer_sort(a, (intT*) NULL, n, max_value, tag, f);
+}
+
+// **************************************************************
+//    LSD RADIX SORT WITH WIDE DIGITS AND WRITE-COMBINING BUFFERS
+// **************************************************************
+
+// Digit widths supported by the write-combining kernel; WC_RADIX picks
+// the widest digit whose staging lines fit in WC_STAGING_BYTES
+#define WC_RADIX 0
+#define WC_MAX_RADIX 16
+// Size of one staging line; a full line is flushed to the output at once
+#define WC_LINE_BYTES 64
+// Size of the staging area of a block by default, that of a typical L2
+#define WC_STAGING_BYTES (1 << 18)
+
+template <class E>
+constexpr int wc_line_length() {
+  return sizeof(E) >= WC_LINE_BYTES ? 1 : WC_LINE_BYTES / sizeof(E);
+}
+
+template <class E, class intT>
+int wc_default_radix() {
+  long line_bytes = sizeof(E) * wc_line_length<E>() + sizeof(intT);
+  int radix_bits = 1;
+  while (radix_bits < WC_MAX_RADIX && (line_bytes << (radix_bits + 1)) <= WC_STAGING_BYTES) {
+    radix_bits++;
+  }
+  return radix_bits;
+}
+
+// Slot of the line of b + i that b[i] falls in; the staged elements of
+// a digit sit at the slots of their destinations, so that, past the first
+// one, flushes write whole aligned lines of the output
+template <class E, class intT>
+intT wc_slot(E* b, intT i) {
+  if (WC_LINE_BYTES % sizeof(E) != 0) {
+    return 0;
+  }
+  return (intT)(((uintptr_t)(b + i) % WC_LINE_BYTES) / sizeof(E));
+}
+
+// Stable scatter of the block a[0, n) to b. dst[d] is the position in b
+// of the first element of digit d coming from this block. Elements are
+// staged in one cache line per digit and written out a line at a time,
+// so that the output is touched in sequential chunks. lines and fill
+// are the staging area, of max_value lines and max_value integers.
+template <class E, class F, class intT>
+void radix_block_wc(E* a, E* b, E* lines, intT* fill, intT* dst,
+                    intT n, intT max_value, F extract) {
+  const intT line_length = wc_line_length<E>();
+  for (intT i = 0; i < max_value; i++) {
+    fill[i] = wc_slot(b, dst[i]);
+  }
+  for (intT j = 0; j < n; j++) {
+    intT k = extract(a[j]);
+    E* line = lines + k * line_length;
+    line[fill[k]++] = a[j];
+    if (fill[k] == line_length) {
+      // the first flush of a digit stops at a line boundary of b
+      intT first = wc_slot(b, dst[k]);
+      std::copy(line + first, line + line_length, b + dst[k]);
+      dst[k] += line_length - first;
+      fill[k] = 0;
+    }
+  }
+  for (intT i = 0; i < max_value; i++) {
+    E* line = lines + i * line_length;
+    intT first = wc_slot(b, dst[i]);
+    std::copy(line + first, line + fill[i], b + dst[i]);
+  }
+}
+
+// One stable counting pass from a to b on the digit given by extract,
+// which must return a non-negative integer less than max_value.
+// counts, offsets and fill must each hold blocks_number * max_value
+// integers, and lines blocks_number * max_value staging lines.
+template <class E, class F, class intT>
+void radix_step_wc(E* a, E* b, intT* counts, intT* offsets, E* lines, intT* fill,
+                   intT blocks_number, intT n, intT max_value, F extract) {
+  intT block_length = (n + blocks_number - 1) / blocks_number;
+  auto block_size = [&] (intT i) {
+    return std::min(block_length, n - std::min(n, i * block_length));
+  };
+  auto comp = [&] (intT lo, intT hi) {
+    return (hi - lo) * (block_length + max_value);
+  };
+  parallel_for(intT(0), blocks_number, comp, [&] (intT i) {
+    intT* cnts = counts + i * max_value;
+    for (intT k = 0; k < max_value; k++) {
+      cnts[k] = 0;
+    }
+    E* block = a + i * block_length;
+    intT m = block_size(i);
+    for (intT j = 0; j < m; j++) {
+      cnts[extract(block[j])]++;
+    }
+  });
+  // bucket-major layout: the scan gives, for each bucket and block, the
+  // position of the first element in the output
+  transpose(counts, offsets, blocks_number, max_value);
+  dps::scan(offsets, offsets + blocks_number * max_value, (intT)0, [&] (intT x, intT y) {
+    return x + y;
+  }, offsets, forward_exclusive_scan);
+  parallel_for(intT(0), blocks_number, comp, [&] (intT i) {
+    // the histogram of this block is not needed anymore, so its slot
+    // is reused for the output positions
+    intT* dst = counts + i * max_value;
+    for (intT k = 0; k < max_value; k++) {
+      dst[k] = offsets[k * blocks_number + i];
+    }
+    radix_block_wc(a + i * block_length, b, lines + i * max_value * wc_line_length<E>(),
+                   fill + i * max_value, dst, block_size(i), max_value, extract);
+  });
+}
+
+// Radix sort with low order bits first, radix_bits bits per pass
+// passes on digits that are the same in all keys are skipped
+template <class E, class F, class intT>
+void radix_loop_bottom_up_wc(E* a, E* b, intT n, int bits, int radix_bits, F f,
+                             varyingT varying = ALL_VARYING) {
+  intT expand = (intT) (sizeof(E) <= 4 ? 64 : 32);
+  int rounds = (bits + radix_bits - 1) / radix_bits;
+  int bits_per_round = (bits + rounds - 1) / rounds;
+  intT max_value = (intT)1 << bits_per_round;
+  intT blocks_number = 1 + n / (max_value * expand);
+  parray<intT> counts;
+  counts.reset(blocks_number * max_value);
+  parray<intT> offsets;
+  offsets.reset(blocks_number * max_value);
+  // the staging area of each block, reused by all passes
+  parray<E> lines;
+  lines.reset(blocks_number * max_value * wc_line_length<E>());
+  parray<intT> fill;
+  fill.reset(blocks_number * max_value);
+  E* from = a;
+  E* to = b;
+  int bit_offset = 0;
+  while (bit_offset < bits) {
+    if (bit_offset + bits_per_round > bits) {
+      bits_per_round = bits - bit_offset;
+    }
+    if (digit_varies(varying, bits_per_round, bit_offset)) {
+      radix_step_wc(from, to, counts.begin(), offsets.begin(), lines.begin(), fill.begin(),
+                    blocks_number, n, (intT)1 << bits_per_round, eBits<intT, E, F>(bits_per_round, bit_offset, f));
+      std::swap(from, to);
+    }
+    bit_offset += bits_per_round;
+  }
+  if (from != a) {
+    sptl::copy(from, from + n, a);
+  }
+}
+
+// Sorts the array a of length n, where f maps each element into an
+// integer in the range [0, max_value). Digits are radix_bits wide,
+// with radix_bits in [1, WC_MAX_RADIX], or WC_RADIX for the default.
+template <class E, class F, class intT>
+void integer_sort_bits_wc(E* a, intT n, int bits, F f, int radix_bits = WC_RADIX) {
+  if (n <= 1) {
+    return;
+  }
+  if (radix_bits == WC_RADIX) {
+    radix_bits = wc_default_radix<E, intT>();
+  }
+  radix_bits = std::max(1, std::min(radix_bits, WC_MAX_RADIX));
+  varyingT varying = varying_bits(a, n, f);
+  if (varying == 0) {
+    return;
+  }
+  int low = lowest_varying(varying);
+  parray<E> b;
+  b.reset(n);
+  radix_loop_bottom_up_wc(a, b.begin(), n, utils::bitWidth(varying) - low, radix_bits,
+                          shifted_key<E, F>(low, f), varying >> low);
+}
+
+template <class E, class F, class intT>
+void integer_sort_bottom_up_wc(E* a, intT n, intT max_value, F f, int radix_bits = WC_RADIX) {
+  integer_sort_bits_wc(a, n, utils::log2Up(max_value), f, radix_bits);
+}
+
  
 } // end namespace
-  
+
+// The keys are the elements themselves, or the first components of the
+// pairs. They must be non-negative and can use all bits of uintT; intT
+// is the type of the counts and offsets.
 template <class intT, class uintT>
 static void integer_sort(uintT* a, intT n) {
-  intT max_value = sptl::max(a, a + n);
-  intsort::integer_sort(a, (intT*) nullptr, n, max_value + 1, [&] (uintT x) { return x; });
+  uintT max_key = sptl::max(a, a + n);
+  intsort::integer_sort_bits(a, n, utils::bitWidth(max_key), [&] (uintT x) { return x; });
+}
+
+template <class intT, class uintT>
+static void integer_sort_in_place(uintT* a, intT n) {
+  uintT max_key = sptl::max(a, a + n);
+  intsort::integer_sort_bits(a, n, utils::bitWidth(max_key), intsort::in_place(), [&] (uintT x) { return x; });
 }
 
+template <class intT, class uintT>
+static void integer_sort_wc(uintT* a, intT n, int radix_bits = WC_RADIX) {
+  uintT max_key = sptl::max(a, a + n);
+  intsort::integer_sort_bits_wc(a, n, utils::bitWidth(max_key), [&] (uintT x) { return x; }, radix_bits);
+}
+
+// Returns the largest first component of the pairs in a[0, n)
 template <class T, class intT, class uintT>
-static void integer_sort(std::pair<uintT, T>* a, intT n) {
+static uintT max_first(std::pair<uintT, T>* a, intT n) {
   auto combine = [&] (uintT a, uintT b) {
     return std::max(a, b);
   };
@@ -257,10 +776,27 @@ static void integer_sort(std::pair<uintT, T>* a, intT n) {
   auto lo = a; auto hi = a + n;
   auto seq_reduce_rng = [&] (std::pair<uintT, T>*  _lo, std::pair<uintT, T>*  _hi) {
     level1::seq_reduce_rng_spec<std::pair<uintT, T>* , value_type_of<std::pair<uintT, T>* >> f;
-    return f.f(_lo - lo, _lo, _hi, 0, combine, lift_idx);
+    return f.f(_lo - lo, _lo, _hi, (uintT)0, combine, lift_idx);
   };
-  int max_value = level2::reduce(a, a + n, 0, combine, lift_comp_rng, lift_idx, seq_reduce_rng);
-  intsort::integer_sort(a, (intT*) nullptr, n, max_value + 1, [&] (std::pair<uintT, T> x) { return x.first; });
+  return level2::reduce(a, a + n, (uintT)0, combine, lift_comp_rng, lift_idx, seq_reduce_rng);
+}
+
+template <class T, class intT, class uintT>
+static void integer_sort(std::pair<uintT, T>* a, intT n) {
+  uintT max_key = max_first(a, n);
+  intsort::integer_sort_bits(a, n, utils::bitWidth(max_key), [&] (std::pair<uintT, T> x) { return x.first; });
+}
+
+template <class T, class intT, class uintT>
+static void integer_sort_in_place(std::pair<uintT, T>* a, intT n) {
+  uintT max_key = max_first(a, n);
+  intsort::integer_sort_bits(a, n, utils::bitWidth(max_key), intsort::in_place(), [&] (std::pair<uintT, T> x) { return x.first; });
+}
+
+template <class T, class intT, class uintT>
+static void integer_sort_wc(std::pair<uintT, T>* a, intT n, int radix_bits = WC_RADIX) {
+  uintT max_key = max_first(a, n);
+  intsort::integer_sort_bits_wc(a, n, utils::bitWidth(max_key), [&] (std::pair<uintT, T> x) { return x.first; }, radix_bits);
 }
   
 } // end namespace
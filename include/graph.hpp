@@ -1,8 +1,11 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
 #include "utils.hpp"
 #include "sprandgen.hpp"
+#include "spdataparallel.hpp"
 //typedef int vindex;
 
 #ifndef _SPTL_GRAPH_INCLUDED
@@ -116,6 +119,273 @@ struct graph {
   }
 };
   
+// **************************************************************
+//    COMPRESSED SPARSE ROW REPRESENTATION
+// **************************************************************
+
+// The neighbors of vertex v are edges[offsets[v], offsets[v + 1]).
+// Offsets are 64 bits wide, so that graphs can have more than 2^31
+// edges, while vertex ids are intT; a vertex costs 8 bytes, instead of
+// the 16 of a vertex with its pointer.
+// If mapped is not NULL, edges points into the private mapping
+// [mapped, mapped + mapped_bytes) of a file, which del unmaps.
+template <class intT>
+struct csr_graph {
+  long* offsets;
+  intT* edges;
+  intT n;
+  long m;
+  char* mapped;
+  long mapped_bytes;
+  csr_graph() : offsets(NULL), edges(NULL), n(0), m(0), mapped(NULL), mapped_bytes(0) {}
+  csr_graph(long* o, intT* e, intT nn, long mm)
+  : offsets(o), edges(e), n(nn), m(mm), mapped(NULL), mapped_bytes(0) {}
+  csr_graph(long* o, intT* e, intT nn, long mm, char* mp, long mb)
+  : offsets(o), edges(e), n(nn), m(mm), mapped(mp), mapped_bytes(mb) {}
+  intT degree(intT v) const {
+    return (intT)(offsets[v + 1] - offsets[v]);
+  }
+  intT* neighbors(intT v) const {
+    return edges + offsets[v];
+  }
+  // Calls f(j, u) for the neighbors u of v of ranks j in [lo, hi), until
+  // f returns false
+  template <class F>
+  void map_neighbors(intT v, intT lo, intT hi, F f) const {
+    const intT* e = edges + offsets[v];
+    for (intT j = lo; j < hi; j++) {
+      if (! f(j, e[j])) {
+        return;
+      }
+    }
+  }
+  // Cost of scanning the neighbors of the vertices [lo, hi)
+  long cost(intT lo, intT hi) const {
+    return offsets[hi] - offsets[lo];
+  }
+  long size_in_bytes() const {
+    return sizeof(long) * ((long)n + 1) + sizeof(intT) * m;
+  }
+  void del() {
+    free(offsets);
+    if (mapped == NULL) {
+      free(edges);
+    } else {
+      munmap(mapped, mapped_bytes);
+    }
+  }
+};
+
+// Fills offsets[0, n] with the exclusive scan of degree(0), ...,
+// degree(n - 1), and returns their sum, which is also offsets[n]
+template <class intT, class Degree>
+long csr_offsets(long* offsets, intT n, Degree degree) {
+  parallel_for((intT)0, n, [&] (intT v) {
+    offsets[v] = degree(v);
+  });
+  offsets[n] = 0;
+  return dps::scan(offsets, offsets + n + 1, 0l, [&] (long x, long y) { return x + y; }, offsets, forward_exclusive_scan);
+}
+
+template <class intT>
+csr_graph<intT> to_csr(const graph<intT>& G) {
+  long* offsets = (long*)malloc(sizeof(long) * ((long)G.n + 1));
+  long m = csr_offsets(offsets, G.n, [&] (intT v) {
+    return G.V[v].degree;
+  });
+  intT* edges = (intT*)malloc(sizeof(intT) * m);
+  parallel_for((intT)0, G.n, [&] (intT v) {
+    std::copy(G.V[v].Neighbors, G.V[v].Neighbors + G.V[v].degree, edges + offsets[v]);
+  });
+  return csr_graph<intT>(offsets, edges, G.n, m);
+}
+
+// **************************************************************
+//    BYTE-CODED COMPRESSED REPRESENTATION
+// **************************************************************
+
+// Following Ligra+, the sorted neighbors of each vertex are cut into
+// blocks of BYTE_GRAPH_BLOCK, and each block is coded as differences in
+// bytes of 7 bits: the first neighbor of a block relative to the vertex,
+// as a signed (zigzag) number, and the others relative to the previous
+// neighbor. The bytes of vertex v start with the 32-bit offsets of its
+// blocks but the first, so that each block can be decoded on its own,
+// e.g. by the tasks of a parallel loop over the neighbors.
+
+#define BYTE_GRAPH_BLOCK 64
+
+typedef unsigned char byteT;
+
+static inline long byte_code_size(unsigned long x) {
+  long size = 1;
+  while (x >= 128) {
+    x >>= 7;
+    size++;
+  }
+  return size;
+}
+
+static inline byteT* byte_encode(byteT* p, unsigned long x) {
+  while (x >= 128) {
+    *p++ = (byteT)(x & 127) | 128;
+    x >>= 7;
+  }
+  *p++ = (byteT)x;
+  return p;
+}
+
+static inline unsigned long byte_decode(const byteT*& p) {
+  unsigned long x = *p & 127;
+  int shift = 7;
+  while (*p++ & 128) {
+    x |= (unsigned long)(*p & 127) << shift;
+    shift += 7;
+  }
+  return x;
+}
+
+static inline unsigned long zigzag(long x) {
+  return ((unsigned long)x << 1) ^ (unsigned long)(x >> 63);
+}
+
+static inline long unzigzag(unsigned long x) {
+  return (long)(x >> 1) ^ -(long)(x & 1);
+}
+
+template <class intT>
+struct byte_graph {
+  // the bytes of vertex v are bytes[offsets[v], offsets[v + 1])
+  long* offsets;
+  intT* degrees;
+  byteT* bytes;
+  intT n;
+  long m;
+  byte_graph() : offsets(NULL), degrees(NULL), bytes(NULL), n(0), m(0) {}
+  byte_graph(long* o, intT* d, byteT* b, intT nn, long mm) : offsets(o), degrees(d), bytes(b), n(nn), m(mm) {}
+  intT degree(intT v) const {
+    return degrees[v];
+  }
+  // Calls f(j, u) for the neighbors u of v of ranks j in [lo, hi), until
+  // f returns false; decoding starts at the block of lo
+  template <class F>
+  void map_neighbors(intT v, intT lo, intT hi, F f) const {
+    if (lo >= hi) {
+      return;
+    }
+    const byteT* p = bytes + offsets[v];
+    intT d = degrees[v];
+    intT block = lo / BYTE_GRAPH_BLOCK;
+    unsigned int start = (unsigned int)(((d + BYTE_GRAPH_BLOCK - 1) / BYTE_GRAPH_BLOCK - 1) * sizeof(unsigned int));
+    if (block > 0) {
+      memcpy(&start, p + (block - 1) * sizeof(unsigned int), sizeof(unsigned int));
+    }
+    const byteT* q = p + start;
+    for (intT j = block * BYTE_GRAPH_BLOCK; j < hi; block++) {
+      intT end = std::min(hi, j + BYTE_GRAPH_BLOCK);
+      intT u = (intT)(v + unzigzag(byte_decode(q)));
+      for (;;) {
+        if (j >= lo && ! f(j, u)) {
+          return;
+        }
+        if (++j == end) {
+          break;
+        }
+        u += (intT)byte_decode(q);
+      }
+    }
+  }
+  long cost(intT lo, intT hi) const {
+    return offsets[hi] - offsets[lo];
+  }
+  long size_in_bytes() const {
+    return sizeof(long) * ((long)n + 1) + sizeof(intT) * n + offsets[n];
+  }
+  void del() {
+    free(offsets);
+    free(degrees);
+    free(bytes);
+  }
+};
+
+// Codes the sorted neighbors e[0, d) of v into p, or only measures them
+// if p is NULL; returns the number of bytes
+template <class intT>
+long byte_code_vertex(intT v, const intT* e, intT d, byteT* p) {
+  long blocks = (d + BYTE_GRAPH_BLOCK - 1) / BYTE_GRAPH_BLOCK;
+  long size = (blocks > 0 ? blocks - 1 : 0) * sizeof(unsigned int);
+  for (long b = 0; b < blocks; b++) {
+    if (b > 0 && p != NULL) {
+      unsigned int start = (unsigned int)size;
+      memcpy(p + (b - 1) * sizeof(unsigned int), &start, sizeof(unsigned int));
+    }
+    intT lo = (intT)(b * BYTE_GRAPH_BLOCK);
+    intT hi = std::min(d, lo + BYTE_GRAPH_BLOCK);
+    unsigned long x = zigzag((long)e[lo] - (long)v);
+    if (p != NULL) {
+      byte_encode(p + size, x);
+    }
+    size += byte_code_size(x);
+    for (intT j = lo + 1; j < hi; j++) {
+      x = (unsigned long)(e[j] - e[j - 1]);
+      if (p != NULL) {
+        byte_encode(p + size, x);
+      }
+      size += byte_code_size(x);
+    }
+  }
+  return size;
+}
+
+// Compresses G, whose neighbor lists are sorted in place
+template <class intT>
+byte_graph<intT> to_byte_graph(csr_graph<intT>& G) {
+  intT n = G.n;
+  parallel_for((intT)0, n, [&] (intT v) {
+    std::sort(G.neighbors(v), G.neighbors(v) + G.degree(v));
+  });
+  intT* degrees = (intT*)malloc(sizeof(intT) * n);
+  parallel_for((intT)0, n, [&] (intT v) {
+    degrees[v] = G.degree(v);
+  });
+  long* offsets = (long*)malloc(sizeof(long) * ((long)n + 1));
+  long size = csr_offsets(offsets, n, [&] (intT v) {
+    return byte_code_vertex(v, G.neighbors(v), G.degree(v), (byteT*)NULL);
+  });
+  byteT* bytes = (byteT*)malloc(std::max(1l, size));
+  parallel_for((intT)0, n, [&] (intT v) {
+    byte_code_vertex(v, G.neighbors(v), G.degree(v), bytes + offsets[v]);
+  });
+  return byte_graph<intT>(offsets, degrees, bytes, n, G.m);
+}
+
+// **************************************************************
+//    VERTEX BITMAP
+// **************************************************************
+
+// One bit per vertex, e.g. for visited sets, which are then 32 times
+// smaller than with an int per vertex
+
+typedef unsigned long bitmap_wordT;
+#define BITMAP_WORD_BITS 64
+
+static inline long bitmap_words(long n) {
+  return (n + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+}
+
+static inline bool bitmap_get(const bitmap_wordT* bits, long v) {
+  return (bits[v / BITMAP_WORD_BITS] >> (v % BITMAP_WORD_BITS)) & 1;
+}
+
+// Sets the bit of v atomically; returns whether this call set it
+static inline bool bitmap_claim(bitmap_wordT* bits, long v) {
+  bitmap_wordT mask = (bitmap_wordT)1 << (v % BITMAP_WORD_BITS);
+  bitmap_wordT* word = &bits[v / BITMAP_WORD_BITS];
+  if (*word & mask) {
+    return false;
+  }
+  return (__sync_fetch_and_or(word, mask) & mask) == 0;
+}
+
 template <class intT>
 std::ostream& operator<<(std::ostream& out, const vertex<intT>& v) {
   out << "{";
@@ -20,6 +20,12 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <algorithm>
+
+#include "quicksort.hpp"
+#include "spdataparallel.hpp"
+#include "spparray.hpp"
+
 // This code breaks with suffixArray if _MERGE_BSIZE is lowered
 // not sure if it is the fault of this code or suffix array
 
@@ -75,6 +81,217 @@ void merge(ET* S1, intT l1, ET* S2, intT l2, ET* R, F f) {
     );
   }, seq);
 }
+
+// ***************************************************************
+//    Multiway merge
+// ***************************************************************
+
+// Output blocks of a multiway merge are filled in parallel, each one
+// by a sequential merge of the slices of the runs that it receives
+#define MULTIWAY_BLOCK (1 << 16)
+
+// Order in which a k-way merge outputs the elements: by value, then by
+// run, so that equal elements keep the order of the runs
+template <class ET, class F>
+inline bool stable_less(const ET& x, int i, const ET& y, int j, F f) {
+  return f(x, y) || (i < j && ! f(y, x));
+}
+
+// Multisequence selection: computes, for each run i, the number pos[i]
+// of its elements that are among the first rank elements of the merge
+template <class ET, class F, class intT>
+void multisequence_select(ET** runs, intT* lengths, int k, intT rank, intT* pos, F f) {
+  parray<intT> lo;
+  lo.reset(k);
+  parray<intT> hi(k, [&] (int i) {
+    return lengths[i];
+  });
+  for (int i = 0; i < k; i++) {
+    lo[i] = 0;
+  }
+  while (true) {
+    // the run with the widest range of candidates provides the pivot
+    int j = -1;
+    for (int i = 0; i < k; i++) {
+      if (hi[i] > lo[i] && (j < 0 || hi[i] - lo[i] > hi[j] - lo[j])) {
+        j = i;
+      }
+    }
+    if (j < 0) {
+      break;
+    }
+    intT mid = lo[j] + (hi[j] - lo[j]) / 2;
+    ET x = runs[j][mid];
+    // number of elements that precede x in each run
+    intT before = 0;
+    for (int i = 0; i < k; i++) {
+      if (i == j) {
+        pos[i] = mid;
+      } else if (i < j) {
+        pos[i] = std::upper_bound(runs[i] + lo[i], runs[i] + hi[i], x, f) - runs[i];
+      } else {
+        pos[i] = std::lower_bound(runs[i] + lo[i], runs[i] + hi[i], x, f) - runs[i];
+      }
+      before += pos[i];
+    }
+    if (before < rank) {
+      // x and everything before it is in the selection
+      for (int i = 0; i < k; i++) {
+        lo[i] = pos[i];
+      }
+      lo[j] = mid + 1;
+    } else {
+      for (int i = 0; i < k; i++) {
+        hi[i] = pos[i];
+      }
+    }
+  }
+  for (int i = 0; i < k; i++) {
+    pos[i] = lo[i];
+  }
+}
+
+// Sequential stable merge of runs[i][lo[i], hi[i]) for i < k into R
+template <class ET, class F, class intT>
+void multiway_merge_seq(ET** runs, intT* lo, intT* hi, int k, ET* R, F f) {
+  parray<intT> cur(k, [&] (int i) {
+    return lo[i];
+  });
+  // binary heap of the nonempty runs, with the smallest head on top
+  parray<int> heap;
+  heap.reset(k);
+  int size = 0;
+  auto after = [&] (int i, int j) {
+    return stable_less(runs[j][cur[j]], j, runs[i][cur[i]], i, f);
+  };
+  for (int i = 0; i < k; i++) {
+    if (lo[i] < hi[i]) {
+      heap[size++] = i;
+    }
+  }
+  std::make_heap(heap.begin(), heap.begin() + size, after);
+  while (size > 1) {
+    std::pop_heap(heap.begin(), heap.begin() + size, after);
+    int i = heap[size - 1];
+    *R++ = runs[i][cur[i]++];
+    if (cur[i] < hi[i]) {
+      std::push_heap(heap.begin(), heap.begin() + size, after);
+    } else {
+      size--;
+    }
+  }
+  if (size == 1) {
+    int i = heap[0];
+    std::copy(runs[i] + cur[i], runs[i] + hi[i], R);
+  }
+}
+
+// Stable parallel merge of the sorted runs[i][0, lengths[i]) for i < k
+// into R: equal elements are output in the order of their runs
+template <class ET, class F, class intT>
+void multiway_merge(ET** runs, intT* lengths, int k, ET* R, F f) {
+  intT n = 0;
+  for (int i = 0; i < k; i++) {
+    n += lengths[i];
+  }
+  intT blocks = (n + MULTIWAY_BLOCK - 1) / MULTIWAY_BLOCK;
+  // splits[b * k + i]: elements of run i that precede output block b
+  parray<intT> splits;
+  splits.reset((blocks + 1) * k);
+  parallel_for((intT)0, blocks + 1, [&] (intT lo, intT hi) {
+    return (hi - lo) * k * k;
+  }, [&] (intT b) {
+    intT* pos = splits.begin() + b * k;
+    if (b == 0) {
+      std::fill(pos, pos + k, (intT)0);
+    } else if (b == blocks) {
+      std::copy(lengths, lengths + k, pos);
+    } else {
+      multisequence_select(runs, lengths, k, b * MULTIWAY_BLOCK, pos, f);
+    }
+  });
+  parallel_for((intT)0, blocks, [&] (intT b) {
+    multiway_merge_seq(runs, splits.begin() + b * k, splits.begin() + (b + 1) * k, k,
+                       R + b * MULTIWAY_BLOCK, f);
+  });
+}
+
+// ***************************************************************
+//    Stable merge sort
+// ***************************************************************
+
+#define MERGE_SORT_THR 16384
+#define MERGE_SORT_WAYS 32
+
+// Stable sequential sort of a[0, n), using tmp[0, n) as scratch
+template <class E, class BinPred, class intT>
+void merge_sort_seq(E* a, E* tmp, intT n, BinPred compare) {
+  for (intT i = 0; i < n; i += ISORT) {
+    insertion_sort(a + i, std::min((intT)ISORT, n - i), compare);
+  }
+  E* from = a;
+  E* to = tmp;
+  for (intT w = ISORT; w < n; w *= 2) {
+    for (intT i = 0; i < n; i += 2 * w) {
+      intT m = std::min(i + w, n);
+      intT e = std::min(i + 2 * w, n);
+      if (m == e || ! compare(from[m], from[m - 1])) {
+        std::copy(from + i, from + e, to + i);
+      } else {
+        std::merge(from + i, from + m, from + m, from + e, to + i, compare);
+      }
+    }
+    std::swap(from, to);
+  }
+  if (from != a) {
+    std::copy(from, from + n, a);
+  }
+}
+
+// Sorts a[0, n) into a, using tmp[0, n) as scratch: the chunks are
+// sorted in parallel, then merged unless they are already in order
+template <class E, class BinPred, class intT>
+void merge_sort(E* a, E* tmp, intT n, BinPred compare) {
+  if (n <= MERGE_SORT_THR) {
+    merge_sort_seq(a, tmp, n, compare);
+    return;
+  }
+  int k = (int)std::min((intT)MERGE_SORT_WAYS, (n + MERGE_SORT_THR - 1) / MERGE_SORT_THR);
+  intT chunk = (n + k - 1) / k;
+  k = (int)((n + chunk - 1) / chunk);
+  parallel_for(0, k, [&] (int lo, int hi) {
+    return (hi - lo) * chunk;
+  }, [&] (int i) {
+    intT lo = i * chunk;
+    intT len = std::min(chunk, n - lo);
+    merge_sort(a + lo, tmp + lo, len, compare);
+  });
+  bool sorted = true;
+  for (int i = 1; i < k; i++) {
+    if (compare(a[i * chunk], a[i * chunk - 1])) {
+      sorted = false;
+    }
+  }
+  if (sorted) {
+    return;
+  }
+  parray<E*> runs(k, [&] (int i) {
+    return a + i * chunk;
+  });
+  parray<intT> lengths(k, [&] (int i) {
+    return std::min(chunk, n - i * chunk);
+  });
+  multiway_merge(runs.begin(), lengths.begin(), k, tmp, compare);
+  sptl::copy(tmp, tmp + n, a);
+}
+
+// Stable parallel sort
+template <class E, class BinPred, class intT>
+void merge_sort(E* a, intT n, BinPred compare) {
+  parray<E> tmp;
+  tmp.reset(n);
+  merge_sort(a, tmp.begin(), n, compare);
+}
   
 } // end namespace
 
@@ -39,34 +39,56 @@ namespace sptl {
 //   Flags = 0 indicates undecided
 //   Flags = 1 indicates chosen
 //   Flags = 2 indicates a neighbor is chosen
+// Iteration i decides the vertex of rank i, so that a vertex waits for
+// its neighbors of lower rank. With no ranks, the rank of a vertex is
+// its id, and the set is the lexicographically first one.
+template <class Graph>
 struct MISstep {
   char flag;
-  char* flags;  graph::vertex<int>* G;
+  char* flags;  Graph G;
+  const intT* order;
+  const intT* rank;
   MISstep() { }
-  MISstep(char* _F, graph::vertex<int>* _G) : flags(_F), G(_G) {}
-  
+  MISstep(char* _F, Graph _G, const intT* _order, const intT* _rank)
+    : flags(_F), G(_G), order(_order), rank(_rank) {}
+
+  intT vertex(intT i) { return (order == NULL) ? i : order[i]; }
+  intT priority(intT v) { return (rank == NULL) ? v : rank[v]; }
+
   bool reserve(intT i) {
-    intT d = G[i].degree;
+    intT v = vertex(i);
     flag = 1;
-    for (intT j = 0; j < d; j++) {
-      intT ngh = G[i].Neighbors[j];
-      if (ngh < i) {
-        if (flags[ngh] == 1) { flag = 2; return 1;}
+    G.map_neighbors(v, 0, G.degree(v), [&] (intT j, intT ngh) {
+      if (priority(ngh) < i) {
+        if (flags[ngh] == 1) { flag = 2; return false;}
         // need to wait for higher priority neighbor to decide
         else if (flags[ngh] == 0) flag = 0;
       }
-    }
+      return true;
+    });
     return 1;
   }
   
-  bool commit(intT i) { return (flags[i] = flag) > 0;}
+  bool commit(intT i) { return (flags[vertex(i)] = flag) > 0;}
 };
 
-parray<char> maximalIndependentSet(graph::graph<int> GS) {
-  intT n = GS.n;
-  graph::vertex<int>* G = GS.V;
+// G is a graph::csr_graph or a graph::byte_graph. rank, if not NULL, is
+// a permutation of the vertices that gives their priorities, e.g. their
+// ids before a relabeling: the rounds then do not depend on the labels,
+// which, under orders such as rcm, give neighbors nearby ids and would
+// let a round settle only a few vertices.
+template <class Graph>
+parray<char> maximalIndependentSet(Graph G, const intT* rank = NULL) {
+  intT n = G.n;
   parray<char> flags(n, (char) 0);
-  MISstep mis(flags.begin(), G);
+  parray<intT> order;
+  if (rank != NULL) {
+    order.reset(n);
+    parallel_for((intT)0, n, [&] (intT v) {
+      order[rank[v]] = v;
+    });
+  }
+  MISstep<Graph> mis(flags.begin(), G, (rank == NULL) ? NULL : order.begin(), rank);
   speculative_for(mis, 0, n, 20);
   return flags;
 }
@@ -4,6 +4,7 @@
 #include "speculativefor.hpp"
 #include "union.hpp"
 #include "samplesort.hpp"
+#include "select.hpp"
 
 #ifndef MST_H_
 #define MST_H_
@@ -51,27 +52,6 @@ struct UnionFindStep {
   }
 };
 
-template <class E, class F>
-int almostKth(E* A, E* B, int k, int n, F f) {
-  int ssize = std::min(1000, n);
-  int stride = n / ssize;
-  int km = (int) (k * ((double) ssize) / n);
-  E T[ssize];
-  for (int i = 0; i < ssize; i++) T[i] = A[i * stride];
-  std::sort(T, T + ssize, f);
-  E p = T[km];
-
-  parray<bool> flags(n, [&] (int i) {
-    return flags[i] = f(A[i], p);
-  });
-  int l = dps::pack(flags.begin(), A, A + n, B);
-  parallel_for(0, n, [&] (int i) {
-    flags[i] = !flags[i];
-  });
-  dps::pack(flags.begin(), A, A + n, B + l);
-  return l;
-}
-
 typedef std::pair<double, int> ei;
 
 struct edgeLess {
@@ -89,7 +69,7 @@ parray<sptl::size_type> mst(graph::wghEdgeArray<int> G) {
   parray<ei> y;
   y.reset(G.m);
 
-  l = almostKth(x.begin(), y.begin(), l, G.m, edgeLess());
+  l = partition_kth(x.begin(), G.m, l, y.begin(), edgeLess());
 
   sample_sort(y.begin(), l, edgeLess());
 
@@ -39,71 +39,76 @@ namespace sptl {
 //      in the new graph are the children in the bfs tree)
 // **************************************************************
 
-std::pair<int,int> pbfs(int start, graph::graph<int> graph) {
-  int numVertices = graph.n;
-  int numEdges = graph.m;
-  const graph::vertex<int>* g = graph.V;
+// Takes a graph::csr_graph or a graph::byte_graph; the neighbors of a
+// vertex are visited in parallel, by ranges of whole blocks of
+// BYTE_GRAPH_BLOCK neighbors, each decoded once
+template <class Graph>
+std::pair<int,int> pbfs(int start, const Graph& g) {
+  int numVertices = g.n;
+  // the frontiers hold each vertex at most once; the slots for the edges
+  // of the frontier are allocated for each round
   parray<int> frontier;
-  frontier.reset(numEdges);
-  parray<int> visited(numVertices, 0);
+  frontier.reset(numVertices);
+  parray<graph::bitmap_wordT> visited(graph::bitmap_words(numVertices), (graph::bitmap_wordT)0);
   parray<int> frontier_next;
-  frontier_next.reset(numEdges);
-  parray<int> counts;
+  parray<long> counts;
   counts.reset(numVertices);
   frontier[0] = start;
   int frontier_size = 1;
-  visited[start] = 1;
+  graph::bitmap_claim(visited.begin(), start);
   int total_visited = 0;
   int round = 0;
   auto visited_ptr = visited.begin();
   auto frontier_ptr = frontier.begin();
-  auto frontier_next_ptr = frontier_next.begin();
   auto counts_ptr = counts.begin();
   while (frontier_size > 0) {
     round++;
     total_visited += frontier_size;
     parallel_for(0, frontier_size, [&] (int l, int r) { return r - l; }, [&, counts_ptr, g, frontier_ptr] (int i) {
-      counts_ptr[i] = g[frontier_ptr[i]].degree;
+      counts_ptr[i] = g.degree(frontier_ptr[i]);
     }, [&, counts_ptr, g, frontier_ptr] (int l, int r) {
       for (int i = l; i < r; i++) {
-        counts_ptr[i] = g[frontier[i]].degree;
+        counts_ptr[i] = g.degree(frontier[i]);
       }
     });
-    int nr = dps::scan(counts.begin(), counts.begin() + frontier_size, 0, [&] (int x, int y) { return x + y; }, counts.begin(), forward_exclusive_scan);
+    long nr = dps::scan(counts.begin(), counts.begin() + frontier_size, 0l, [&] (long x, long y) { return x + y; }, counts.begin(), forward_exclusive_scan);
+    frontier_next.reset(nr);
+    auto frontier_next_ptr = frontier_next.begin();
     // For each vertexB in the frontier try to "hook" unvisited neighbors.
     parallel_for(0, frontier_size, [&] (int l, int r) { return (r == frontier_size ? nr : counts_ptr[r]) - counts_ptr[l] + (r - l); }, [&, frontier_next_ptr, frontier_ptr, g, visited_ptr] (int i) {
       int k = 0;
       int v = frontier_ptr[i];
-      int o = counts_ptr[i];
-      parallel_for(0, g[v].degree, [&] (int l, int r) { return r - l; }, [&, frontier_next_ptr, g, visited_ptr] (int j) {
-        int ngh = g[v].Neighbors[j];
-        if (visited_ptr[ngh] == 0 && !__sync_val_compare_and_swap(&visited_ptr[ngh], 0, 1)) {
+      long o = counts_ptr[i];
+      auto hook = [&, frontier_next_ptr, visited_ptr] (int j, int ngh) {
+        if (graph::bitmap_claim(visited_ptr, ngh)) {
           frontier_next_ptr[o + j] = ngh;
         } else {
           frontier_next_ptr[o + j] = -1;
         }
-      }, [&, frontier_next_ptr, g, visited_ptr] (int l, int r) {
-        for (int j = l; j < r; j++) {
-          int ngh = g[v].Neighbors[j];
-          if (visited_ptr[ngh] == 0 && !__sync_val_compare_and_swap(&visited_ptr[ngh], 0, 1)) {
-            frontier_next_ptr[o + j] = ngh;
-          } else {
-            frontier_next_ptr[o + j] = -1;
-          }
-        }
-      });
+        return true;
+      };
+      // the neighbors are split at block boundaries, where the decoding
+      // of a byte_graph can start
+      int d = g.degree(v);
+      int blocks = (d + BYTE_GRAPH_BLOCK - 1) / BYTE_GRAPH_BLOCK;
+      auto neighbors = [&, g] (int l, int r) {
+        g.map_neighbors(v, l * BYTE_GRAPH_BLOCK, (int)std::min((long)d, (long)r * BYTE_GRAPH_BLOCK), hook);
+      };
+      parallel_for(0, blocks, [&] (int l, int r) { return (long)(r - l) * BYTE_GRAPH_BLOCK; }, [&] (int b) {
+        neighbors(b, b + 1);
+      }, neighbors);
     }, [&, frontier_next_ptr, frontier_ptr, g, visited_ptr] (int l, int r) {
       for (int i = l; i < r; i++) {
         int k = 0;
         int v = frontier_ptr[i];
-        int o = counts_ptr[i];
-        for (int j = 0; j < g[v].degree; j++) {
-          int ngh = g[v].Neighbors[j];
-          if (visited_ptr[ngh] == 0 && !__sync_val_compare_and_swap(&visited_ptr[ngh], 0, 1)) {
+        long o = counts_ptr[i];
+        g.map_neighbors(v, 0, g.degree(v), [&] (int j, int ngh) {
+          if (graph::bitmap_claim(visited_ptr, ngh)) {
             frontier_next_ptr[o + j] = ngh;
           }
           else frontier_next_ptr[o + j] = -1;
-        }
+          return true;
+        });
         //       g[v].degree = k;
       }
     });
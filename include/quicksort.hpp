@@ -21,6 +21,7 @@
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <algorithm>
+#include <type_traits>
 
 #include "spdataparallel.hpp"
 
@@ -81,6 +82,183 @@ void quick_sort(E* A, intT n, BinPred f) {
     std::sort(A, A + n, f);
   }*/);
 }
+
+// ***************************************************************
+//    Branchless block quicksort
+// ***************************************************************
+
+// Partitions in the style of BlockQuicksort (Edelkamp and Weiss) and
+// pdqsort: the comparisons of a block are stored as offsets before
+// any element is moved, so that the outcome of a comparison never
+// decides a branch. Tiny ranges are sorted by sorting networks.
+
+#define BQSORT_BLOCK 64
+#define BQSORT_NINTHER 128
+#define BQSORT_NETWORK 8
+
+template <class E, class BinPred>
+inline void compare_exchange(E& x, E& y, BinPred f) {
+  E a = x;
+  E b = y;
+  bool c = f(b, a);
+  x = c ? b : a;
+  y = c ? a : b;
+}
+
+// Optimal sorting networks for 2 to BQSORT_NETWORK elements
+static const unsigned char sorting_network_pairs[] = {
+  0,1,
+  1,2, 0,2, 0,1,
+  0,1, 2,3, 0,2, 1,3, 1,2,
+  0,1, 3,4, 2,4, 2,3, 0,3, 0,2, 1,4, 1,3, 1,2,
+  1,2, 4,5, 0,2, 3,5, 0,1, 3,4, 1,4, 0,3, 2,5, 1,3, 2,4, 2,3,
+  1,2, 3,4, 5,6, 0,2, 3,5, 4,6, 0,1, 4,5, 2,6, 0,4, 1,5, 0,3, 2,5, 1,3, 2,4, 2,3,
+  0,1, 2,3, 4,5, 6,7, 0,2, 1,3, 4,6, 5,7, 1,2, 5,6, 0,4, 3,7, 1,5, 2,6, 1,4, 3,6, 2,4, 3,5, 3,4
+};
+
+// Offset in sorting_network_pairs and number of comparators, for each n
+static const unsigned char sorting_network_offsets[] = { 0, 0, 0, 1, 4, 9, 18, 30, 46 };
+static const unsigned char sorting_network_sizes[] = { 0, 0, 1, 3, 5, 9, 12, 16, 19 };
+
+template <class E, class BinPred, class intT>
+void sorting_network(E* A, intT n, BinPred f) {
+  const unsigned char* pairs = sorting_network_pairs + 2 * sorting_network_offsets[n];
+  for (int i = 0; i < sorting_network_sizes[n]; i++) {
+    compare_exchange(A[pairs[2 * i]], A[pairs[2 * i + 1]], f);
+  }
+}
+
+// Moves the median of A[i], A[j] and A[k] to A[j]
+template <class E, class BinPred, class intT>
+inline void sort3(E* A, intT i, intT j, intT k, BinPred f) {
+  compare_exchange(A[i], A[j], f);
+  compare_exchange(A[j], A[k], f);
+  compare_exchange(A[i], A[j], f);
+}
+
+// Partitions A[1, n) around the pivot A[0]: returns m such that the
+// elements x of A[1, m) are those satisfying goes_left(x)
+template <class E, class Pred, class intT>
+intT block_partition(E* A, intT n, Pred goes_left) {
+  unsigned char offsets_l[BQSORT_BLOCK];
+  unsigned char offsets_r[BQSORT_BLOCK];
+  E* l = A + 1;
+  E* r = A + n;
+  int start_l = 0, start_r = 0, num_l = 0, num_r = 0;
+  while (r - l > 2 * BQSORT_BLOCK) {
+    if (num_l == 0) {
+      start_l = 0;
+      for (int i = 0; i < BQSORT_BLOCK; i++) {
+        offsets_l[num_l] = i;
+        num_l += ! goes_left(l[i]);
+      }
+    }
+    if (num_r == 0) {
+      start_r = 0;
+      for (int i = 0; i < BQSORT_BLOCK; i++) {
+        offsets_r[num_r] = i;
+        num_r += goes_left(r[-1 - i]);
+      }
+    }
+    int num = std::min(num_l, num_r);
+    for (int i = 0; i < num; i++) {
+      std::swap(l[offsets_l[start_l + i]], r[-1 - offsets_r[start_r + i]]);
+    }
+    num_l -= num;
+    num_r -= num;
+    start_l += num;
+    start_r += num;
+    if (num_l == 0) {
+      l += BQSORT_BLOCK;
+    }
+    if (num_r == 0) {
+      r -= BQSORT_BLOCK;
+    }
+  }
+  // branchless Lomuto on the remaining (at most 2 * BQSORT_BLOCK) elements
+  E* m = l;
+  for (E* p = l; p < r; p++) {
+    E x = *p;
+    bool c = goes_left(x);
+    *p = *m;
+    *m = x;
+    m += c;
+  }
+  return m - A;
+}
+
+// If has_pred, A[-1] is not greater than any element of A[0, n), which
+// lets runs of keys equal to it be skipped in one partition
+template <class E, class BinPred, class intT>
+void block_quick_sort(E* A, intT n, BinPred f, bool has_pred, int bad_allowed) {
+  spguard([&] { return n * log(n); }, [&] {
+    if (n <= BQSORT_NETWORK) {
+      sorting_network(A, n, f);
+      return;
+    }
+    if (n < ISORT) {
+      insertion_sort(A, n, f);
+      return;
+    }
+    if (bad_allowed == 0) {
+      std::partial_sort(A, A + n, A + n, f);
+      return;
+    }
+    intT h = n / 2;
+    if (n > BQSORT_NINTHER) {
+      sort3(A, (intT)0, h, n - 1, f);
+      sort3(A, (intT)1, h - 1, n - 2, f);
+      sort3(A, (intT)2, h + 1, n - 3, f);
+      sort3(A, h - 1, h, h + 1, f);
+    } else {
+      sort3(A, (intT)0, h, n - 1, f);
+    }
+    std::swap(A[0], A[h]);
+    E p = A[0];
+    if (has_pred && ! f(A[-1], p)) {
+      // the pivot equals A[-1]: put the keys equal to it on the left, where
+      // they are in their final place
+      intT m = block_partition(A, n, [&] (const E& x) { return ! f(p, x); });
+      block_quick_sort(A + m, n - m, f, true, bad_allowed);
+      return;
+    }
+    intT m = block_partition(A, n, [&] (const E& x) { return f(x, p); });
+    std::swap(A[0], A[m - 1]);
+    intT l = m - 1;
+    intT r = n - m;
+    if (l < n / 8 || r < n / 8) {
+      bad_allowed--;
+    }
+    fork2([&] {
+      block_quick_sort(A, l, f, has_pred, bad_allowed);
+    }, [&] {
+      block_quick_sort(A + m, r, f, true, bad_allowed);
+    });
+  });
+}
+
+template <class E, class BinPred, class intT>
+void block_quick_sort(E* A, intT n, BinPred f) {
+  int bad_allowed = 1;
+  for (intT i = n; i > 1; i /= 2) {
+    bad_allowed++;
+  }
+  block_quick_sort(A, n, f, false, bad_allowed);
+}
+
+// Key types for which branchless partitioning pays off, i.e. cheap to
+// compare and to move; may be specialized for other types
+template <class E>
+struct use_block_quick_sort : std::is_arithmetic<E> {};
+
+template <class E, class BinPred, class intT>
+void leaf_sort(E* A, intT n, BinPred f) {
+  if (use_block_quick_sort<E>::value) {
+    block_quick_sort(A, n, f);
+  } else {
+    quick_sort(A, n, f);
+  }
+}
   
 } // end namespace
 
@@ -0,0 +1,242 @@
+
+#include <algorithm>
+#include <limits>
+
+#include "utils.hpp"
+#include "spdataparallel.hpp"
+#include "spparray.hpp"
+#include "graph.hpp"
+#include "sort.hpp"
+
+#ifndef _PBBS_SPTL_REORDER_H_
+#define _PBBS_SPTL_REORDER_H_
+
+namespace sptl {
+
+// ***************************************************************
+//    Vertex reordering
+// ***************************************************************
+
+// A vertex order is a permutation perm of the vertices of a graph, where
+// perm[v] is the new id of v; relabel rewrites a graph with these ids.
+// The orders improve the locality of graph traversals: with the degree
+// order, the high-degree vertices, which most edges point to, share a
+// few cache lines; with the reverse Cuthill-McKee order, the neighbors
+// of a vertex get ids close to its own. The graph must be symmetric.
+
+// Gives uniform access to the adjacency of graph::graph and csr_graph
+template <class intT>
+intT reorder_degree(const graph::graph<intT>& G, intT v) {
+  return G.V[v].degree;
+}
+
+template <class intT>
+const intT* reorder_neighbors(const graph::graph<intT>& G, intT v) {
+  return G.V[v].Neighbors;
+}
+
+template <class intT>
+intT reorder_degree(const graph::csr_graph<intT>& G, intT v) {
+  return G.degree(v);
+}
+
+template <class intT>
+const intT* reorder_neighbors(const graph::csr_graph<intT>& G, intT v) {
+  return G.neighbors(v);
+}
+
+// Inverts the permutation p; this turns a list of the vertices by new id
+// into a vertex order, and back
+template <class intT>
+parray<intT> inverse_permutation(const intT* p, intT n) {
+  parray<intT> q(n);
+  parallel_for((intT)0, n, [&] (intT i) {
+    q[p[i]] = i;
+  });
+  return q;
+}
+
+// Sorts the vertices by decreasing degree; vertices of equal degree keep
+// their relative order
+template <class Graph, class intT>
+parray<intT> degree_order(const Graph& G, intT n) {
+  parray<intT> keys(n, [&] (intT v) {
+    return -reorder_degree(G, v);
+  });
+  parray<intT> order(n, [&] (intT v) {
+    return v;
+  });
+  sort_by_key(keys.begin(), order.begin(), n);
+  return inverse_permutation(order.begin(), n);
+}
+
+template <class intT>
+parray<intT> degree_order(const graph::csr_graph<intT>& G) {
+  return degree_order(G, G.n);
+}
+
+template <class intT>
+parray<intT> degree_order(const graph::graph<intT>& G) {
+  return degree_order(G, G.n);
+}
+
+// Cuthill-McKee numbers the vertices level by level from a start vertex:
+// the vertices of a level come in the order of their first neighbor in
+// the previous level, and those of a same neighbor by increasing degree.
+// A level is numbered in parallel: each unvisited neighbor of the level
+// records its first neighbor in it by a writeMin, and each vertex of the
+// level then sorts the neighbors that recorded it. The ids are finally
+// reversed. A component starts from its first unvisited vertex, except
+// the first one, which starts from a vertex of least nonzero degree, as
+// such vertices tend to be far from the others.
+template <class Graph, class intT>
+parray<intT> rcm_order(const Graph& G, intT n, long m) {
+  parray<intT> order(n);
+  parray<intT> owner(n, n);
+  parray<graph::bitmap_wordT> visited(graph::bitmap_words(n), (graph::bitmap_wordT)0);
+  parray<long> offsets(n + 1);
+  parray<intT> slots(std::max(m, 1l));
+  auto visited_ptr = visited.begin();
+  auto by_degree = [&] (intT u, intT v) {
+    intT du = reorder_degree(G, u);
+    intT dv = reorder_degree(G, v);
+    return du < dv || (du == dv && u < v);
+  };
+  intT start = level1::reducei(owner.cbegin(), owner.cend(), n, [&] (intT u, intT v) {
+    if (u == n || v == n) {
+      return std::min(u, v);
+    }
+    return by_degree(u, v) ? u : v;
+  }, [&] (long v, intT) {
+    return reorder_degree(G, (intT)v) > 0 ? (intT)v : n;
+  });
+  intT numbered = 0;
+  intT cursor = 0;
+  if (start == n) {
+    start = 0;
+  }
+  while (numbered < n) {
+    graph::bitmap_claim(visited_ptr, start);
+    order[numbered] = start;
+    intT lo = numbered;
+    intT hi = numbered + 1;
+    while (lo < hi) {
+      intT* frontier = order.begin() + lo;
+      intT frontier_size = hi - lo;
+      parallel_for((intT)0, frontier_size, [&] (intT i) {
+        const intT* ngh = reorder_neighbors(G, frontier[i]);
+        for (intT j = 0; j < reorder_degree(G, frontier[i]); j++) {
+          if (! graph::bitmap_get(visited_ptr, ngh[j])) {
+            utils::writeMin(&owner[ngh[j]], i);
+          }
+        }
+      });
+      long nr = graph::csr_offsets(offsets.begin(), frontier_size, [&] (intT i) {
+        return reorder_degree(G, frontier[i]);
+      });
+      parallel_for((intT)0, frontier_size, [&] (intT i) {
+        const intT* ngh = reorder_neighbors(G, frontier[i]);
+        intT* s = slots.begin() + offsets[i];
+        intT d = reorder_degree(G, frontier[i]);
+        intT k = 0;
+        for (intT j = 0; j < d; j++) {
+          // the claim skips the duplicates of a neighbor
+          if (owner[ngh[j]] == i && graph::bitmap_claim(visited_ptr, ngh[j])) {
+            s[k++] = ngh[j];
+          }
+        }
+        std::sort(s, s + k, by_degree);
+        std::fill(s + k, s + d, (intT)-1);
+      });
+      intT next_size = (intT)dps::filter(slots.begin(), slots.begin() + nr, order.begin() + hi, [&] (intT v) {
+        return v >= 0;
+      });
+      lo = hi;
+      hi += next_size;
+    }
+    numbered = hi;
+    while (cursor < n && graph::bitmap_get(visited_ptr, cursor)) {
+      cursor++;
+    }
+    start = cursor;
+  }
+  parray<intT> perm(n);
+  parallel_for((intT)0, n, [&] (intT i) {
+    perm[order[i]] = n - 1 - i;
+  });
+  return perm;
+}
+
+template <class intT>
+parray<intT> rcm_order(const graph::csr_graph<intT>& G) {
+  return rcm_order(G, G.n, G.m);
+}
+
+template <class intT>
+parray<intT> rcm_order(const graph::graph<intT>& G) {
+  return rcm_order(G, G.n, (long)G.m);
+}
+
+// ***************************************************************
+//    Relabeling
+// ***************************************************************
+
+// The relabeled graphs are new, and the neighbors of each vertex are
+// sorted by their new ids, so that a vertex visits them in memory order
+
+template <class intT>
+graph::csr_graph<intT> relabel(const graph::csr_graph<intT>& G, const intT* perm) {
+  intT n = G.n;
+  parray<intT> order = inverse_permutation(perm, n);
+  long* offsets = (long*)malloc(sizeof(long) * ((long)n + 1));
+  long m = graph::csr_offsets(offsets, n, [&] (intT i) {
+    return G.degree(order[i]);
+  });
+  intT* edges = (intT*)malloc(sizeof(intT) * m);
+  parallel_for((intT)0, n, [&] (intT i) {
+    const intT* ngh = G.neighbors(order[i]);
+    intT d = G.degree(order[i]);
+    intT* e = edges + offsets[i];
+    for (intT j = 0; j < d; j++) {
+      e[j] = perm[ngh[j]];
+    }
+    std::sort(e, e + d);
+  });
+  return graph::csr_graph<intT>(offsets, edges, n, m);
+}
+
+template <class intT>
+graph::graph<intT> relabel(const graph::graph<intT>& G, const intT* perm) {
+  intT n = G.n;
+  parray<intT> order = inverse_permutation(perm, n);
+  parray<long> offsets(n + 1);
+  long m = graph::csr_offsets(offsets.begin(), n, [&] (intT i) {
+    return G.V[order[i]].degree;
+  });
+  graph::vertex<intT>* V = newA(graph::vertex<intT>, n);
+  intT* edges = newA(intT, m);
+  parallel_for((intT)0, n, [&] (intT i) {
+    const graph::vertex<intT>& u = G.V[order[i]];
+    intT* e = edges + offsets[i];
+    for (intT j = 0; j < u.degree; j++) {
+      e[j] = perm[u.Neighbors[j]];
+    }
+    std::sort(e, e + u.degree);
+    V[i] = graph::vertex<intT>(e, u.degree);
+  });
+  return graph::graph<intT>(V, n, (intT)m, edges);
+}
+
+// Renames the endpoints of the edges, which keep their order
+template <class intT>
+graph::edgeArray<intT> relabel(const graph::edgeArray<intT>& A, const intT* perm) {
+  graph::edge<intT>* E = newA(graph::edge<intT>, A.nonZeros);
+  parallel_for((intT)0, A.nonZeros, [&] (intT i) {
+    E[i] = graph::edge<intT>(perm[A.E[i].u], perm[A.E[i].v]);
+  });
+  return graph::edgeArray<intT>(E, A.numRows, A.numCols, A.nonZeros);
+}
+
+} // end namespace
+
+#endif
@@ -26,6 +26,7 @@
 
 #include "utils.hpp"
 #include "quicksort.hpp"
+#include "merge.hpp"
 #include "transpose.hpp"
 #include "sprandgen.hpp"
 #include "spparray.hpp"
@@ -71,11 +72,58 @@ void split_positions(E* a, E* b, intT* c, intT length_a, intT length_b, BinPred
 #define SSORT_THR 100000
 #define AVG_SEG_SIZE 2
 #define PIVOT_QUOT 2
+// A call of size n uses at most n / SSORT_SAMPLE_QUOT elements for its
+// samples and pivots, given n > SSORT_THR
+#define SSORT_SAMPLE_QUOT 64
+
+// Scratch space for sample_sort, allocated once and reused across calls
+// on arrays of at most n elements. A call at recursion depth d on the
+// subarray at position p uses the slices at p of b, of meta[d] and (at
+// p / SSORT_SAMPLE_QUOT) of samples[d], which are disjoint from those
+// of the calls that run in parallel with it. Calls deeper than the
+// number of levels allocate their own space.
+template <class E, class intT>
+struct sample_sort_workspace {
+  intT n;
+  parray<E> b;
+  parray<parray<E>> samples;
+  parray<parray<intT>> meta;
+
+  sample_sort_workspace() : n(0) {}
+  sample_sort_workspace(intT n, int levels = 1) : n(0) {
+    reset(n, levels);
+  }
+
+  void reset(intT _n, int levels = 1) {
+    n = _n;
+    b.reset(n);
+    samples.reset(levels);
+    meta.reset(levels);
+    for (int d = 0; d < levels; d++) {
+      samples[d].reset(n / SSORT_SAMPLE_QUOT + 1);
+      meta[d].reset(2 * n);
+    }
+  }
+
+  int levels() const {
+    return (int)meta.size();
+  }
+};
 
 template<class E, class BinPred, class intT>
-void sample_sort (E* a, intT n, BinPred compare) {
+void sample_sort(E* a, intT n, BinPred compare, bool stable,
+                 sample_sort_workspace<E, intT>* ws, int level, intT position) {
+  bool use_ws = ws != NULL && level < ws->levels();
   if (n <= SSORT_THR) {
-    quick_sort(a, n, compare);
+    if (! stable) {
+      leaf_sort(a, n, compare);
+    } else if (ws != NULL) {
+      merge_sort_seq(a, ws->b.begin() + position, n, compare);
+    } else {
+      parray<E> tmp;
+      tmp.reset(n);
+      merge_sort_seq(a, tmp.begin(), n, compare);
+    }
     return;
   }
   intT sq = (intT) sqrt(n);
@@ -84,84 +132,128 @@ void sample_sort (E* a, intT n, BinPred compare) {
   // number of pivots + 1
   intT segments = (sq - 1) / PIVOT_QUOT;
   if (segments <= 1) {
-    std::sort(a, a + n, compare);
+    if (stable) {
+      std::stable_sort(a, a + n, compare);
+    } else {
+      std::sort(a, a + n, compare);
+    }
     return;
   }
   int over_sample = 4;
   intT sample_set_size = segments * over_sample;
+  int pivots_size = segments - 1;
+  intT segments_number = rows * (2 * segments - 1);
+  // either slices of the workspace or fresh arrays
+  parray<E> local_samples;
+  parray<E> local_b;
+  parray<intT> local_meta;
+  E* sample_set;
+  E* b;
+  intT* meta;
+  if (use_ws) {
+    sample_set = ws->samples[level].begin() + (position + SSORT_SAMPLE_QUOT - 1) / SSORT_SAMPLE_QUOT;
+    b = ws->b.begin() + position;
+    meta = ws->meta[level].begin() + 2 * position;
+  } else {
+    local_samples.reset(sample_set_size + pivots_size);
+    sample_set = local_samples.begin();
+    if (ws != NULL) {
+      b = ws->b.begin() + position;
+    } else {
+      local_b.reset(n);
+      b = local_b.begin();
+    }
+    local_meta.reset(3 * segments_number + pivots_size + 1);
+    meta = local_meta.begin();
+  }
+  E* pivots = sample_set + sample_set_size;
+  intT* segments_sizes = meta;
+  intT* offset_a = meta + segments_number;
+  intT* offset_b = meta + 2 * segments_number;
+  intT* complexities = meta + 3 * segments_number;
   // generate samples with oversampling
-  parray<E> sample_set(sample_set_size, [&] (intT j) {
+  parallel_for((intT)0, sample_set_size, [&] (intT j) {
     intT o = hashi(j) % n;
-    return a[o];
+    sample_set[j] = a[o];
   });
   // sort the samples
-  quick_sort(sample_set.begin(), sample_set_size, compare);
+  leaf_sort(sample_set, sample_set_size, compare);
   // subselect samples at even stride
-  int pivots_size = segments - 1;
-  parray<E> pivots(segments - 1, [&] (intT k) {
+  parallel_for((intT)0, (intT)pivots_size, [&] (intT k) {
     intT o = over_sample * k;
-    return sample_set[o];
+    pivots[k] = sample_set[o];
   });
-  sample_set.clear();
   segments = 2 * segments - 1;
-  parray<E> b;
-  b.reset(rows * row_length);
-  parray<intT> segments_sizes;
-  segments_sizes.reset(rows * segments);
-  parray<intT> offset_a;
-  offset_a.reset(rows * segments);
-  parray<intT> offset_b;
-  offset_b.reset(rows * segments);
   // sort each row and merge with samples to get counts
   parallel_for((intT)0, rows, [&] (intT lo, intT hi) { return (hi - lo) * row_length; }, [&] (intT r) {
     intT offset = r * row_length;
     intT size = (r < rows - 1) ? row_length : n - offset;
-    sample_sort(a + offset, size, compare);
-    split_positions(a + offset, pivots.begin(), segments_sizes.begin() + r * segments, size, (intT)pivots.size(), compare);
+    sample_sort(a + offset, size, compare, stable, ws, level + 1, position + offset);
+    split_positions(a + offset, pivots, segments_sizes + r * segments, size, (intT)pivots_size, compare);
   });
   // transpose from rows to columns
   auto plus = [&] (intT x, intT y) {
     return x + y;
   };
-  dps::scan(segments_sizes.begin(), segments_sizes.end(), (intT)0, plus, offset_a.begin(), forward_exclusive_scan);
-  transpose(segments_sizes.begin(), offset_b.begin(), rows, segments);
-  dps::scan(offset_b.begin(), offset_b.end(), (intT)0, plus, offset_b.begin(), forward_exclusive_scan);
-  block_transpose(a, b.begin(), offset_a.begin(), offset_b.begin(), segments_sizes.begin(), rows, segments);
-  sptl::copy(b.begin(), b.begin() + n, a);
+  dps::scan(segments_sizes, segments_sizes + segments_number, (intT)0, plus, offset_a, forward_exclusive_scan);
+  transpose(segments_sizes, offset_b, rows, segments);
+  dps::scan(offset_b, offset_b + segments_number, (intT)0, plus, offset_b, forward_exclusive_scan);
+  block_transpose(a, b, offset_a, offset_b, segments_sizes, rows, segments);
+  sptl::copy(b, b + n, a);
   // sort the columns
-  parray<intT> complexities(pivots_size + 1, [&] (int i) {
+  parallel_for((intT)0, (intT)(pivots_size + 1), [&] (intT i) {
     double s = (i == 0 || i == pivots_size || compare(pivots[i - 1], pivots[i])) ?
                (i == pivots_size ? n : offset_b[(2 * i + 1) * rows]) - offset_b[2 * i * rows] :
                1;
-    return s * (log(s) + 1);
+    complexities[i] = s * (log(s) + 1);
   });
-  dps::scan(complexities.begin(), complexities.end(), (intT)0, plus, complexities.begin(), forward_inclusive_scan);
+  dps::scan(complexities, complexities + pivots_size + 1, (intT)0, plus, complexities, forward_inclusive_scan);
   auto complexity_fct = [&] (intT lo, intT hi) {
     if (lo == hi) {
-      return 0;
+      return (intT)0;
     } else if (lo == 0) {
       return complexities[hi - 1];
     } else {
       return complexities[hi - 1] - complexities[lo - 1];
     }
   };
-  b.clear();
-  offset_a.clear();
-  segments_sizes.clear();
+  local_b.clear();
   parallel_for((intT)0, (intT)(pivots_size + 1), complexity_fct, [&] (intT i) {
     intT offset = offset_b[(2 * i) * rows];
     if (i == 0) {
-      sample_sort(a, offset_b[rows], compare); // first segment
+      sample_sort(a, offset_b[rows], compare, stable, ws, level + 1, position); // first segment
     } else if (i < pivots_size) { // middle segments
       if (compare(pivots[i - 1], pivots[i])) {
-        sample_sort(a + offset, offset_b[(2 * i + 1) * rows] - offset, compare);
+        sample_sort(a + offset, offset_b[(2 * i + 1) * rows] - offset, compare, stable, ws, level + 1, position + offset);
       }
     } else { // last segment
-      sample_sort(a + offset, n - offset, compare);
+      sample_sort(a + offset, n - offset, compare, stable, ws, level + 1, position + offset);
     }
   });
 }
 
+template<class E, class BinPred, class intT>
+void sample_sort(E* a, intT n, BinPred compare) {
+  sample_sort(a, n, compare, false, (sample_sort_workspace<E, intT>*) NULL, 0, (intT)0);
+}
+
+// Reuses the space of ws, which must have been sized for at least n elements
+template<class E, class BinPred, class intT>
+void sample_sort(E* a, intT n, BinPred compare, sample_sort_workspace<E, intT>& ws) {
+  sample_sort(a, n, compare, false, &ws, 0, (intT)0);
+}
+
+// Stable versions: elements that compare equal keep their relative order
+template<class E, class BinPred, class intT>
+void stable_sample_sort(E* a, intT n, BinPred compare) {
+  sample_sort(a, n, compare, true, (sample_sort_workspace<E, intT>*) NULL, 0, (intT)0);
+}
+
+template<class E, class BinPred, class intT>
+void stable_sample_sort(E* a, intT n, BinPred compare, sample_sort_workspace<E, intT>& ws) {
+  sample_sort(a, n, compare, true, &ws, 0, (intT)0);
+}
+
 } // end namespace
 
 #define comparison_sort(__A, __n, __f) (sample_sort(__A, __n, __f))
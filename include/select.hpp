@@ -0,0 +1,167 @@
+
+#include <algorithm>
+#include <math.h>
+
+#include "samplesort.hpp"
+#include "sprandgen.hpp"
+#include "spparray.hpp"
+
+#ifndef _PBBS_SPTL_SELECT_H_
+#define _PBBS_SPTL_SELECT_H_
+
+namespace sptl {
+
+// ***************************************************************
+//    Parallel selection
+// ***************************************************************
+
+// Each round sorts a sample, takes two pivots around the rank of k in
+// it, and keeps only the elements between the pivots, which contain
+// the answer with high probability (otherwise the round keeps the side
+// that does). Ranks are exact: the answer is never approximated.
+
+#define SELECT_THR 16384
+#define SELECT_SAMPLES 1024
+
+// Elements of a[0, n) that compare less than p, equal to p and greater
+// than p are written in this order into b; returns the end of the
+// elements less than p and the end of those equal to p
+template <class E, class F, class intT>
+std::pair<intT, intT> partition3(E* a, intT n, E p, E* b, F f) {
+  intT l = (intT)dps::filter(a, a + n, b, [&] (const E& x) {
+    return f(x, p);
+  });
+  intT m = l + (intT)dps::filter(a, a + n, b + l, [&] (const E& x) {
+    return ! f(x, p) && ! f(p, x);
+  });
+  dps::filter(a, a + n, b + m, [&] (const E& x) {
+    return f(p, x);
+  });
+  return std::make_pair(l, m);
+}
+
+// Numbers of elements of a round relative to its pivots
+template <class intT>
+struct select_counts {
+  intT less_lo;
+  intT equal_lo;
+  intT equal_hi;
+  intT greater_hi;
+};
+
+// Returns the element of rank k (from 0) of a[0, n), which is left as
+// it is; tmp is scratch space of n elements
+template <class E, class F, class intT>
+E select_kth(E* a, intT n, intT k, F f, E* tmp) {
+  if (n <= SELECT_THR) {
+    std::copy(a, a + n, tmp);
+    std::nth_element(tmp, tmp + k, tmp + n, f);
+    return tmp[k];
+  }
+  intT s = SELECT_SAMPLES;
+  parray<E> sample(s, [&] (intT i) {
+    return a[hashi(i) % n];
+  });
+  sample_sort(sample.begin(), s, f);
+  intT ks = (intT)((double)k * s / n);
+  intT delta = (intT)sqrt((double)s);
+  E lo = sample[std::max((intT)0, ks - delta)];
+  E hi = sample[std::min(s - 1, ks + delta)];
+  sample.clear();
+  // count the elements below lo, equal to lo, equal to hi and above hi
+  select_counts<intT> zero = { 0, 0, 0, 0 };
+  auto counts = level1::reduce(a, a + n, zero, [&] (select_counts<intT> x, select_counts<intT> y) {
+    select_counts<intT> z = { x.less_lo + y.less_lo, x.equal_lo + y.equal_lo,
+                              x.equal_hi + y.equal_hi, x.greater_hi + y.greater_hi };
+    return z;
+  }, [&] (E x) {
+    bool less_lo = f(x, lo);
+    bool greater_hi = f(hi, x);
+    select_counts<intT> c = { less_lo, ! less_lo && ! f(lo, x),
+                              ! greater_hi && ! f(x, hi), greater_hi };
+    return c;
+  });
+  intT below = counts.less_lo;
+  intT above = n - counts.greater_hi;
+  if (k >= below && k < above && ! f(lo, hi)) {
+    // all the elements between the pivots are equal
+    return lo;
+  }
+  // the ranks of the elements equal to a pivot are known, so that the
+  // elements between the pivots are those strictly between them: each
+  // round drops at least the pivots, even when they are the extreme
+  // elements, as on inputs with few distinct keys
+  if (k >= below && k < below + counts.equal_lo) {
+    return lo;
+  }
+  if (k >= above - counts.equal_hi && k < above) {
+    return hi;
+  }
+  parray<E> b;
+  intT m;
+  if (k < below) {
+    b.reset(below);
+    m = (intT)dps::filter(a, a + n, b.begin(), [&] (const E& x) {
+      return f(x, lo);
+    });
+  } else if (k >= above) {
+    b.reset(n - above);
+    m = (intT)dps::filter(a, a + n, b.begin(), [&] (const E& x) {
+      return f(hi, x);
+    });
+    k -= above;
+  } else {
+    b.reset(above - counts.equal_hi - below - counts.equal_lo);
+    m = (intT)dps::filter(a, a + n, b.begin(), [&] (const E& x) {
+      return f(lo, x) && f(x, hi);
+    });
+    k -= below + counts.equal_lo;
+  }
+  return select_kth(b.begin(), m, k, f, tmp);
+}
+
+template <class E, class F, class intT>
+E select_kth(E* a, intT n, intT k, F f) {
+  parray<E> tmp;
+  tmp.reset(n);
+  return select_kth(a, n, k, f, tmp.begin());
+}
+
+// Writes the elements of a[0, n) into b so that b[0, k) holds the k
+// smallest ones, and b[k, n) the others; returns k
+template <class E, class F, class intT>
+intT partition_kth(E* a, intT n, intT k, E* b, F f) {
+  if (k <= 0 || k >= n) {
+    sptl::copy(a, a + n, b);
+    return std::max((intT)0, std::min(k, n));
+  }
+  E p = select_kth(a, n, k, f, b);
+  partition3(a, n, p, b, f);
+  return k;
+}
+
+// Returns the k smallest elements of a[0, n), in no particular order
+template <class E, class F, class intT>
+parray<E> top_k(E* a, intT n, intT k, F f) {
+  parray<E> b;
+  b.reset(n);
+  k = partition_kth(a, n, k, b.begin(), f);
+  b.resize(k);
+  return b;
+}
+
+// Rearranges a[0, n) so that a[0, k) holds its k smallest elements in
+// order, and a[k, n) the others
+template <class E, class F, class intT>
+void partial_sort(E* a, intT n, intT k, F f) {
+  parray<E> b;
+  b.reset(n);
+  k = partition_kth(a, n, k, b.begin(), f);
+  sptl::copy(b.begin(), b.end(), a);
+  b.clear();
+  sample_sort(a, k, f);
+}
+
+} // end namespace
+
+#endif
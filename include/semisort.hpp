@@ -0,0 +1,209 @@
+
+#include <algorithm>
+
+#include "blockradixsort.hpp"
+#include "sprandgen.hpp"
+#include "spparray.hpp"
+
+#ifndef _PBBS_SPTL_SEMISORT_H_
+#define _PBBS_SPTL_SEMISORT_H_
+
+namespace sptl {
+
+namespace semisorting {
+
+// ***************************************************************
+//    Parallel semisort
+// ***************************************************************
+
+// Groups equal keys together without ordering the groups. Each level
+// samples the keys to find the heavy ones, which are frequent enough to
+// get a bucket of their own, and hashes the other (light) keys into the
+// remaining buckets; one distribution pass of integer_sort then makes
+// every bucket contiguous, and the light buckets are semisorted
+// recursively with a fresh hash. Small inputs are grouped sequentially
+// with a hash table.
+
+#define SEMISORT_THR 65536
+#define SEMISORT_SAMPLES 4096
+// A key is heavy if it occurs at least SEMISORT_SAMPLES / SEMISORT_HEAVY
+// times in the sample, i.e. in about one in SEMISORT_HEAVY elements
+#define SEMISORT_HEAVY 256
+#define SEMISORT_MAX_LEVELS 8
+
+typedef unsigned long long hashT;
+
+static inline hashT hash64(hashT x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Hash of level: independent of those of the other levels
+static inline hashT level_hash(hashT h, int level) {
+  return hash64(h + (hashT)level * 0x9e3779b97f4a7c15ULL);
+}
+
+// Groups the keys of a[0, n) by counting them in a hash table, then
+// moving each element to the range of its key
+template <class E, class Key, class Hash, class Eq, class intT>
+void semisort_seq(E* a, intT n, Key key, Hash hash, Eq eq) {
+  if (n < 2) {
+    return;
+  }
+  intT size = (intT)1 << utils::log2Up(2 * n);
+  hashT mask = size - 1;
+  // for each slot, the first element with its key and the count of that key
+  parray<intT> firsts;
+  firsts.reset(size);
+  parray<intT> counts;
+  counts.reset(size);
+  parray<intT> slots;
+  slots.reset(n);
+  std::fill(firsts.begin(), firsts.end(), (intT)-1);
+  std::fill(counts.begin(), counts.end(), (intT)0);
+  for (intT i = 0; i < n; i++) {
+    hashT h = hash(key(a[i])) & mask;
+    while (firsts[h] >= 0 && ! eq(key(a[firsts[h]]), key(a[i]))) {
+      h = (h + 1) & mask;
+    }
+    if (firsts[h] < 0) {
+      firsts[h] = i;
+    }
+    counts[h]++;
+    slots[i] = (intT)h;
+  }
+  intT offset = 0;
+  for (intT h = 0; h < size; h++) {
+    intT c = counts[h];
+    counts[h] = offset;
+    offset += c;
+  }
+  parray<E> b;
+  b.reset(n);
+  for (intT i = 0; i < n; i++) {
+    b[counts[slots[i]]++] = a[i];
+  }
+  std::copy(b.begin(), b.end(), a);
+}
+
+// Open addressing table of the heavy keys, mapping them to their indices
+template <class K, class Hash, class Eq>
+struct heavy_table {
+  parray<K> keys;
+  parray<int> ids;
+  hashT mask;
+  Hash hash;
+  Eq eq;
+
+  heavy_table(int capacity, Hash hash, Eq eq) : hash(hash), eq(eq) {
+    int size = 1 << utils::log2Up(2 * std::max(1, capacity));
+    keys.reset(size);
+    ids.reset(size);
+    sptl::fill(ids.begin(), ids.end(), -1);
+    mask = size - 1;
+  }
+
+  void insert(const K& k, int id) {
+    hashT i = hash(k) & mask;
+    while (ids[i] >= 0) {
+      i = (i + 1) & mask;
+    }
+    keys[i] = k;
+    ids[i] = id;
+  }
+
+  // index of k, or -1 if k is not heavy
+  int find(const K& k) const {
+    hashT i = hash(k) & mask;
+    while (ids[i] >= 0) {
+      if (eq(keys[i], k)) {
+        return ids[i];
+      }
+      i = (i + 1) & mask;
+    }
+    return -1;
+  }
+};
+
+template <class E, class Key, class Hash, class Eq, class intT>
+void semisort_rec(E* a, intT n, Key key, Hash hash, Eq eq, int level) {
+  if (n <= SEMISORT_THR || level >= SEMISORT_MAX_LEVELS) {
+    semisort_seq(a, n, key, hash, eq);
+    return;
+  }
+  typedef typename std::decay<decltype(key(a[0]))>::type K;
+  // sample the keys, and group the sample so that equal keys are adjacent
+  intT samples_number = std::min(n, (intT)SEMISORT_SAMPLES);
+  parray<E> samples(samples_number, [&] (intT i) {
+    return a[(hashT)level_hash(i, level) % n];
+  });
+  semisort_seq(samples.begin(), samples_number, key, hash, eq);
+  intT threshold = std::max((intT)2, samples_number / SEMISORT_HEAVY);
+  auto same_key = [&] (intT i, intT j) {
+    return eq(key(samples[i]), key(samples[j]));
+  };
+  heavy_table<K, Hash, Eq> heavy(SEMISORT_HEAVY, hash, eq);
+  int heavy_number = 0;
+  for (intT i = 0; i < samples_number; ) {
+    intT j = i + 1;
+    while (j < samples_number && same_key(i, j)) {
+      j++;
+    }
+    if (j - i >= threshold && heavy_number < BUCKETS / 2) {
+      heavy.insert(key(samples[i]), heavy_number++);
+    }
+    i = j;
+  }
+  samples.clear();
+  // one distribution pass over the heavy and light buckets
+  intT light_number = BUCKETS - heavy_number;
+  intT buckets_number = BUCKETS;
+  auto bucket = [&] (const E& x) {
+    const K& k = key(x);
+    int id = heavy_number > 0 ? heavy.find(k) : -1;
+    if (id >= 0) {
+      return (intT)id;
+    }
+    hashT h = level_hash(hash(k), level) >> 32;
+    return (intT)(heavy_number + ((h * (hashT)light_number) >> 32));
+  };
+  parray<intT> offsets;
+  offsets.reset(buckets_number);
+  intsort::integer_sort(a, offsets.begin(), n, buckets_number, bucket);
+  parallel_for((intT)heavy_number, buckets_number, [&] (intT lo, intT hi) {
+    return (hi == buckets_number ? n : offsets[hi]) - offsets[lo];
+  }, [&] (intT i) {
+    intT lo = offsets[i];
+    intT hi = i == buckets_number - 1 ? n : offsets[i + 1];
+    semisort_rec(a + lo, hi - lo, key, hash, eq, level + 1);
+  });
+}
+
+} // end namespace
+
+// Rearranges a[0, n) so that the elements whose keys are equal are
+// contiguous. key maps an element to its key, hash maps a key to a
+// 64-bit hash, and eq compares two keys
+template <class E, class Key, class Hash, class Eq, class intT>
+void semisort(E* a, intT n, Key key, Hash hash, Eq eq) {
+  semisorting::semisort_rec(a, n, key, hash, eq, 0);
+}
+
+// A version for integer keys
+template <class E, class Key, class intT>
+void semisort(E* a, intT n, Key key) {
+  typedef typename std::decay<decltype(key(a[0]))>::type K;
+  semisort(a, n, key, [&] (const K& k) {
+    return semisorting::hash64((semisorting::hashT)k);
+  }, [&] (const K& x, const K& y) {
+    return x == y;
+  });
+}
+
+} // end namespace
+
+#endif
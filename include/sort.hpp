@@ -0,0 +1,277 @@
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+#include "utils.hpp"
+#include "blockradixsort.hpp"
+#include "merge.hpp"
+#include "quicksort.hpp"
+#include "samplesort.hpp"
+#include "spparray.hpp"
+
+#ifndef _PBBS_SPTL_SORT_H_
+#define _PBBS_SPTL_SORT_H_
+
+namespace sptl {
+
+// ***************************************************************
+//    Adaptive sort
+// ***************************************************************
+
+// sort makes one parallel pass over the input to count its descents and
+// ascents and find its extreme keys, then picks the engine:
+//  - none if the input is sorted, a parallel reversal if it is reversed
+//  - leaf_sort for small inputs
+//  - merge_sort for almost sorted inputs, whose runs it does not merge
+//  - radix sort for integer keys ordered by std::less, when the range
+//    of the keys fits in SORT_RADIX_BITS bits
+//  - sample_sort of indices for large elements, which then move twice,
+//    by a parallel gather into a buffer and a copy back
+//  - sample_sort otherwise
+// Duplicates need no estimate: sample_sort skips the buckets of keys
+// equal to a pivot, and radix sort does not depend on them.
+
+#define SORT_SEQ_THR 16384
+#define SORT_STATS_BLOCK 8192
+// At most n / SORT_ALMOST_SORTED descents make an input almost sorted
+#define SORT_ALMOST_SORTED 64
+#define SORT_RADIX_BITS 32
+// Elements of at least this many bytes are sorted indirectly
+#define SORT_LARGE_ELEMENT 64
+
+enum sort_engine {
+  sort_engine_presorted,
+  sort_engine_reversed,
+  sort_engine_leaf,
+  sort_engine_merge,
+  sort_engine_radix,
+  sort_engine_indirect,
+  sort_engine_sample
+};
+
+static inline const char* sort_engine_name(sort_engine e) {
+  switch (e) {
+    case sort_engine_presorted: return "presorted";
+    case sort_engine_reversed: return "reversed";
+    case sort_engine_leaf: return "leaf_sort";
+    case sort_engine_merge: return "merge_sort";
+    case sort_engine_radix: return "integer_sort";
+    case sort_engine_indirect: return "indirect_sample_sort";
+    default: return "sample_sort";
+  }
+}
+
+template <class E, class intT>
+struct sort_stats {
+  intT descents;
+  intT ascents;
+  E min;
+  E max;
+};
+
+template <class E, class F, class intT>
+sort_stats<E, intT> input_stats(E* a, intT n, F f) {
+  intT blocks = (n + SORT_STATS_BLOCK - 1) / SORT_STATS_BLOCK;
+  parray<sort_stats<E, intT>> stats(blocks, [&] (intT b) {
+    intT lo = b * SORT_STATS_BLOCK;
+    intT hi = std::min(n, lo + SORT_STATS_BLOCK);
+    sort_stats<E, intT> s;
+    s.descents = 0;
+    s.ascents = 0;
+    s.min = a[lo];
+    s.max = a[lo];
+    // each block also compares its first element with the one before
+    for (intT i = std::max((intT)1, lo); i < hi; i++) {
+      s.descents += f(a[i], a[i - 1]);
+      s.ascents += f(a[i - 1], a[i]);
+      if (f(a[i], s.min)) {
+        s.min = a[i];
+      }
+      if (f(s.max, a[i])) {
+        s.max = a[i];
+      }
+    }
+    return s;
+  });
+  sort_stats<E, intT> s = stats[0];
+  for (intT b = 1; b < blocks; b++) {
+    s.descents += stats[b].descents;
+    s.ascents += stats[b].ascents;
+    if (f(stats[b].min, s.min)) {
+      s.min = stats[b].min;
+    }
+    if (f(s.max, stats[b].max)) {
+      s.max = stats[b].max;
+    }
+  }
+  return s;
+}
+
+// Whether keys of type E ordered by F can be radix sorted
+template <class E, class F>
+struct radix_sortable {
+  static const bool value = std::is_integral<E>::value && ! std::is_same<E, bool>::value &&
+                            std::is_same<F, std::less<E>>::value;
+};
+
+// Radix sorts a[0, n), whose keys are in [min, max], unless this range
+// needs more than SORT_RADIX_BITS bits; returns whether it did
+template <class E, class intT>
+bool radix_sort_range(E* a, intT n, E min, E max, std::true_type) {
+  typedef typename std::make_unsigned<E>::type U;
+  U base = (U)min;
+  int bits = utils::bitWidth((U)((U)max - base));
+  if (bits > SORT_RADIX_BITS) {
+    return false;
+  }
+  intsort::integer_sort_bits(a, n, bits, [&] (E x) {
+    return (U)((U)x - base);
+  });
+  return true;
+}
+
+template <class E, class intT>
+bool radix_sort_range(E* a, intT n, E min, E max, std::false_type) {
+  return false;
+}
+
+// Sorts a[0, n) by sorting indices, so that the sort moves indices only;
+// the elements are then gathered in parallel into a buffer of n elements
+// and copied back, two moves each, however deep the sort
+template <class E, class F, class intT>
+void indirect_sort(E* a, intT n, F f) {
+  parray<intT> indices(n, [&] (intT i) {
+    return i;
+  });
+  sample_sort(indices.begin(), n, [&] (intT i, intT j) {
+    return f(a[i], a[j]);
+  });
+  parray<E> b(n, [&] (intT i) {
+    return a[indices[i]];
+  });
+  sptl::copy(b.begin(), b.end(), a);
+}
+
+// Sorts a[0, n), not stably; returns the engine used
+template <class E, class F, class intT>
+sort_engine sort(E* a, intT n, F f) {
+  if (n < 2) {
+    return sort_engine_presorted;
+  }
+  sort_stats<E, intT> s = input_stats(a, n, f);
+  if (s.descents == 0) {
+    return sort_engine_presorted;
+  }
+  if (s.ascents == 0) {
+    parallel_for((intT)0, n / 2, [&] (intT i) {
+      std::swap(a[i], a[n - 1 - i]);
+    });
+    return sort_engine_reversed;
+  }
+  if (n <= SORT_SEQ_THR) {
+    leaf_sort(a, n, f);
+    return sort_engine_leaf;
+  }
+  if (s.descents <= n / SORT_ALMOST_SORTED) {
+    merge_sort(a, n, f);
+    return sort_engine_merge;
+  }
+  if (radix_sort_range(a, n, s.min, s.max, std::integral_constant<bool, radix_sortable<E, F>::value>())) {
+    return sort_engine_radix;
+  }
+  if (sizeof(E) >= SORT_LARGE_ELEMENT) {
+    indirect_sort(a, n, f);
+    return sort_engine_indirect;
+  }
+  sample_sort(a, n, f);
+  return sort_engine_sample;
+}
+
+template <class E, class intT>
+sort_engine sort(E* a, intT n) {
+  return sptl::sort(a, n, std::less<E>());
+}
+
+// ***************************************************************
+//    Sort by key
+// ***************************************************************
+
+// sort_by_key sorts keys[0, n) stably and moves values[0, n) along.
+// Each pass of the sort moves only a key and its 32-bit position; the
+// values move once at the end, by a gather through these positions, so
+// the traffic of a pass does not depend on the size of the values.
+
+typedef unsigned int key_indexT;
+
+// Radix sorts the (key, position) pairs p[0, n), whose keys are in
+// [min, max], unless this range needs more than SORT_RADIX_BITS bits;
+// returns whether it did
+template <class K, class indexT, class intT>
+bool radix_sort_keyed(std::pair<K, indexT>* p, intT n, K min, K max, std::true_type) {
+  typedef typename std::make_unsigned<K>::type U;
+  U base = (U)min;
+  int bits = utils::bitWidth((U)((U)max - base));
+  if (bits > SORT_RADIX_BITS) {
+    return false;
+  }
+  // the radix sort is stable, so equal keys keep the order of positions
+  intsort::integer_sort_bits(p, n, bits, [&] (const std::pair<K, indexT>& x) {
+    return (U)((U)x.first - base);
+  });
+  return true;
+}
+
+template <class K, class indexT, class intT>
+bool radix_sort_keyed(std::pair<K, indexT>* p, intT n, K min, K max, std::false_type) {
+  return false;
+}
+
+template <class K, class V, class F, class indexT, class intT>
+void sort_by_key(K* keys, V* values, intT n, F f, const sort_stats<K, intT>& s, indexT) {
+  typedef std::pair<K, indexT> keyed;
+  parray<keyed> p(n, [&] (intT i) {
+    return keyed(keys[i], (indexT)i);
+  });
+  if (! radix_sort_keyed(p.begin(), n, s.min, s.max, std::integral_constant<bool, radix_sortable<K, F>::value>())) {
+    // the positions break the ties, which makes the sort stable
+    sample_sort(p.begin(), n, [&] (const keyed& x, const keyed& y) {
+      return f(x.first, y.first) || (! f(y.first, x.first) && x.second < y.second);
+    });
+  }
+  parray<V> v(n, [&] (intT i) {
+    return values[p[i].second];
+  });
+  parallel_for((intT)0, n, [&] (intT i) {
+    keys[i] = p[i].first;
+  });
+  p.clear();
+  sptl::copy(v.begin(), v.end(), values);
+}
+
+// Sorts keys[0, n) stably, and permutes values[0, n) in the same way
+template <class K, class V, class F, class intT>
+void sort_by_key(K* keys, V* values, intT n, F f) {
+  if (n < 2) {
+    return;
+  }
+  sort_stats<K, intT> s = input_stats(keys, n, f);
+  if (s.descents == 0) {
+    return;
+  }
+  if ((unsigned long)n <= (unsigned long)std::numeric_limits<key_indexT>::max()) {
+    sort_by_key(keys, values, n, f, s, key_indexT());
+  } else {
+    sort_by_key(keys, values, n, f, s, intT());
+  }
+}
+
+template <class K, class V, class intT>
+void sort_by_key(K* keys, V* values, intT n) {
+  sort_by_key(keys, values, n, std::less<K>());
+}
+
+} // end namespace
+
+#endif
@@ -0,0 +1,131 @@
+
+#include <string.h>
+#include <type_traits>
+
+#include "samplesort.hpp"
+#include "spdataparallel.hpp"
+#include "spparray.hpp"
+
+#ifndef _PBBS_SPTL_STRINGSORT_H_
+#define _PBBS_SPTL_STRINGSORT_H_
+
+namespace sptl {
+
+// ***************************************************************
+//    Multikey string sort with cached characters
+// ***************************************************************
+
+// At each level, the next STRING_CACHE_BYTES characters of every string
+// are packed big-endian into an integer stored next to the pointer, so
+// that comparisons touch neither the strings nor shared prefixes. The
+// pairs are sorted by this integer; each run of equal integers whose
+// strings continue past it is then sorted in parallel at the next depth.
+
+#define STRING_CACHE_BYTES 8
+#define STRING_ISORT 32
+
+typedef unsigned long long string_cacheT;
+
+struct cached_string {
+  string_cacheT key;
+  char* s;
+};
+
+template <>
+struct use_block_quick_sort<cached_string> : std::true_type {};
+
+// Characters s[0, STRING_CACHE_BYTES), zero-padded after the end of s
+static inline string_cacheT string_cache(const char* s) {
+  string_cacheT k = 0;
+  int i = 0;
+  for (; i < STRING_CACHE_BYTES; i++) {
+    unsigned char c = s[i];
+    k = (k << 8) | c;
+    if (c == 0) {
+      break;
+    }
+  }
+  for (i++; i < STRING_CACHE_BYTES; i++) {
+    k <<= 8;
+  }
+  return k;
+}
+
+// The string whose cache is k ends within these characters
+static inline bool string_ends(string_cacheT k) {
+  return (k & 0xff) == 0;
+}
+
+// All strings of a[0, n) share their first depth characters, and t is
+// scratch space of n elements
+template <class intT>
+void string_sort_rec(char** a, cached_string* t, intT n, intT depth) {
+  if (n < STRING_ISORT) {
+    insertion_sort(a, n, [&] (const char* x, const char* y) {
+      return strcmp(x + depth, y + depth) < 0;
+    });
+    return;
+  }
+  parallel_for((intT)0, n, [&] (intT i) {
+    t[i].key = string_cache(a[i] + depth);
+    t[i].s = a[i];
+  });
+  // skip over characters shared by all the strings without sorting
+  string_cacheT k = t[0].key;
+  intT nb_equal = level1::reduce(t, t + n, (intT)0, [&] (intT x, intT y) {
+    return x + y;
+  }, [&] (cached_string x) {
+    return (intT)(x.key == k);
+  });
+  if (nb_equal == n) {
+    if (! string_ends(k)) {
+      string_sort_rec(a, t, n, depth + STRING_CACHE_BYTES);
+    }
+    return;
+  }
+  sample_sort(t, n, [&] (const cached_string& x, const cached_string& y) {
+    return x.key < y.key;
+  });
+  parallel_for((intT)0, n, [&] (intT i) {
+    a[i] = t[i].s;
+  });
+  // starts of the runs of equal keys
+  parray<intT> starts(n + 1, [&] (intT i) {
+    return (i == 0 || i == n || t[i].key != t[i - 1].key) ? 1 : 0;
+  });
+  intT runs = dps::scan(starts.begin(), starts.end(), (intT)0, [&] (intT x, intT y) {
+    return x + y;
+  }, starts.begin(), forward_exclusive_scan);
+  // offsets of the runs, followed by n
+  intT nb_runs = runs - 1;
+  parray<intT> offsets;
+  offsets.reset(runs);
+  offsets[nb_runs] = n;
+  parallel_for((intT)0, n, [&] (intT i) {
+    if (starts[i] != starts[i + 1]) {
+      offsets[starts[i]] = i;
+    }
+  });
+  starts.clear();
+  parallel_for((intT)0, nb_runs, [&] (intT lo, intT hi) {
+    return offsets[hi] - offsets[lo];
+  }, [&] (intT r) {
+    intT lo = offsets[r];
+    intT hi = offsets[r + 1];
+    if (hi - lo > 1 && ! string_ends(t[lo].key)) {
+      string_sort_rec(a + lo, t + lo, hi - lo, depth + STRING_CACHE_BYTES);
+    }
+  });
+}
+
+// Sorts the strings of a[0, n) in strcmp order
+template <class intT>
+void string_sort(char** a, intT n) {
+  parray<cached_string> t;
+  t.reset(n);
+  string_sort_rec(a, t.begin(), n, (intT)0);
+}
+
+} // end namespace
+
+#endif
@@ -1,4 +1,11 @@
 
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "spdataparallel.hpp"
 
 #ifndef _PBBS_SPTL_TRANSPOSE
@@ -6,18 +13,102 @@
 
 namespace sptl {
 
+// Side of the tiles in which the base case of transpose proceeds
+#define TRANSPOSE_TILE 8
+// Segments of block_transpose at least this long (in bytes) are copied
+// with non-temporal stores, which bypass the cache
+#define TRANSPOSE_STREAM_BYTES 4096
+
+// SIMD transposition of a square tile of SIMD_TILE x SIMD_TILE elements
+// of size Bytes: A and B point to the top-left corners, and lda and ldb
+// are the strides, in elements
+template <int Bytes>
+struct simd_tile {
+  static const bool available = false;
+  static const int size = 1;
+  static void transpose(const char* A, long lda, char* B, long ldb) {}
+};
+
+#if defined(__SSE2__)
+template <>
+struct simd_tile<4> {
+  static const bool available = true;
+  static const int size = 4;
+  static void transpose(const char* A, long lda, char* B, long ldb) {
+    __m128i r0 = _mm_loadu_si128((const __m128i*)(A + 0 * 4 * lda));
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(A + 1 * 4 * lda));
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(A + 2 * 4 * lda));
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(A + 3 * 4 * lda));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    _mm_storeu_si128((__m128i*)(B + 0 * 4 * ldb), _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(B + 1 * 4 * ldb), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(B + 2 * 4 * ldb), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i*)(B + 3 * 4 * ldb), _mm_unpackhi_epi64(t2, t3));
+  }
+};
+
+template <>
+struct simd_tile<8> {
+  static const bool available = true;
+  static const int size = 2;
+  static void transpose(const char* A, long lda, char* B, long ldb) {
+    __m128i r0 = _mm_loadu_si128((const __m128i*)(A + 0 * 8 * lda));
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(A + 1 * 8 * lda));
+    _mm_storeu_si128((__m128i*)(B + 0 * 8 * ldb), _mm_unpacklo_epi64(r0, r1));
+    _mm_storeu_si128((__m128i*)(B + 1 * 8 * ldb), _mm_unpackhi_epi64(r0, r1));
+  }
+};
+#endif
+
+template <class E>
+struct use_simd_tile {
+  static const bool value = std::is_trivially_copyable<E>::value && simd_tile<sizeof(E)>::available;
+};
+
+// B[j*cLength + i] = A[i*rLength + j] for rows i of [rStart, rEnd) and
+// columns j of [cStart, cEnd), one TRANSPOSE_TILE square at a time
+template <class E, class intT>
+void transpose_seq(E* A, E* B,
+                   intT rStart, intT rEnd, intT rLength,
+                   intT cStart, intT cEnd, intT cLength) {
+  typedef simd_tile<sizeof(E)> simd;
+  for (intT ii = rStart; ii < rEnd; ii += TRANSPOSE_TILE) {
+    intT ie = std::min(ii + TRANSPOSE_TILE, rEnd);
+    for (intT jj = cStart; jj < cEnd; jj += TRANSPOSE_TILE) {
+      intT je = std::min(jj + TRANSPOSE_TILE, cEnd);
+      intT i = ii;
+      if (use_simd_tile<E>::value) {
+        for (; i + simd::size <= ie; i += simd::size) {
+          intT j = jj;
+          for (; j + simd::size <= je; j += simd::size) {
+            simd::transpose((const char*)(A + i*rLength + j), (long)rLength,
+                            (char*)(B + j*cLength + i), (long)cLength);
+          }
+          for (; j < je; j++)
+            for (intT k = i; k < i + simd::size; k++)
+              B[j*cLength + k] = A[k*rLength + j];
+        }
+      }
+      for (; i < ie; i++)
+        for (intT j = jj; j < je; j++)
+          B[j*cLength + i] = A[i*rLength + j];
+    }
+  }
+}
+
 template <class E, class intT>
 void transpose(E* A, E* B,
                intT rStart, intT rCount, intT rLength,
                intT cStart, intT cCount, intT cLength) {
 
   auto seq = [&] {
-    for (intT i=rStart; i < rStart + rCount; i++)
-      for (intT j=cStart; j < cStart + cCount; j++)
-        B[j*cLength + i] = A[i*rLength + j];
+    transpose_seq(A, B, rStart, rStart + rCount, rLength, cStart, cStart + cCount, cLength);
   };
   spguard( [&] { return rCount * cCount; }, [&] {
-    if (cCount < 2 && rCount < 2) {
+    if (cCount <= TRANSPOSE_TILE && rCount <= TRANSPOSE_TILE) {
       seq();
     } else if (cCount > rCount) {
       intT l1 = cCount/2;
@@ -36,25 +127,54 @@ void transpose(E* A, E* B,
 
 template <class E, class intT>
 void transpose(E* A, E* B, intT rCount, intT cCount) {
-  transpose(A, B, 0,rCount,cCount,0,cCount,rCount);
+  transpose(A, B, (intT)0,rCount,cCount,(intT)0,cCount,rCount);
 }
 
   
+// Copies l elements from pa to pb, returns whether it used non-temporal
+// stores (which the caller must then fence)
+template <class E, class intT>
+bool copy_segment(E* pa, E* pb, intT l) {
+#if defined(__SSE2__)
+  if (std::is_trivially_copyable<E>::value && l * sizeof(E) >= TRANSPOSE_STREAM_BYTES) {
+    char* src = (char*)pa;
+    char* dst = (char*)pb;
+    size_t bytes = l * sizeof(E);
+    size_t head = (16 - ((size_t)dst & 15)) & 15;
+    memcpy(dst, src, head);
+    size_t i = head;
+    for (; i + 16 <= bytes; i += 16) {
+      _mm_stream_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+    }
+    memcpy(dst + i, src + i, bytes - i);
+    return true;
+  }
+#endif
+  for (intT k=0; k < l; k++) *(pb++) = *(pa++);
+  return false;
+}
+
 template <class E, class intT>
 void block_transpose(E *A, E *B, intT *OA, intT *OB, intT *L,
                      intT rStart, intT rCount, intT rLength,
                      intT cStart, intT cCount, intT cLength) {
 
   auto seq = [&] {
+    bool streamed = false;
     for (intT i=rStart; i < rStart + rCount; i++)
       for (intT j=cStart; j < cStart + cCount; j++) {
         E* pa = A+OA[i*rLength + j];
         E* pb = B+OB[j*cLength + i];
         intT l = L[i*rLength + j];
-        for (intT k=0; k < l; k++) *(pb++) = *(pa++);
+        streamed |= copy_segment(pa, pb, l);
       }
+#if defined(__SSE2__)
+    if (streamed) {
+      _mm_sfence();
+    }
+#endif
   };
-  int total = cCount * rCount;
+  intT total = cCount * rCount;
   spguard([&] { return total; }, [&] {
     if (cCount < 2 && rCount < 2) {
       seq();
@@ -79,7 +199,7 @@ void block_transpose(E *A, E *B, intT *OA, intT *OB, intT *L,
 template <class E, class intT>
 void block_transpose(E *A, E *B, intT *OA, intT *OB, intT *L,
                      intT rCount, intT cCount) {
-  block_transpose(A, B, OA, OB, L, 0,rCount,cCount,0,cCount,rCount);
+  block_transpose(A, B, OA, OB, L, (intT)0,rCount,cCount,(intT)0,cCount,rCount);
 }
 
   
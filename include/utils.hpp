@@ -17,6 +17,15 @@ static int log2Up(T i) {
   return a;
 }
 
+// returns the number of bits needed to represent i, that is
+// log2Up(i + 1) without overflowing when i is the largest value of T
+template <class T>
+static int bitWidth(T i) {
+  int a=0;
+  while (i > 0) {i = i >> 1; a++;}
+  return a;
+}
+
 static int logUp(unsigned int i) {
   int a=0;
   int b=i-1;